@@ -48,12 +48,23 @@
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <execution>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/blocked_range2d.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
 #include "gif.h"          // Tiny GIF encoder (https://github.com/charlietangora/gif-h)
 
 // ── Compile‑time switches ───────────────────────────────────────────────────
@@ -71,7 +82,65 @@ struct Cell {
   CellState state;
   uint8_t   level;   // gameplay strength (0‑255) — no longer affects colour
 };
-using Grid = std::vector<std::vector<Cell>>;   // grid[row][col]
+
+// Copy the opposite edges of a (height + 2) × (width + 2) plane into its halo:
+// left/right columns first, then the top/bottom rows (corners included).
+template <typename T>
+void refresh_plane_halo(std::vector<T> &cells, size_t width, size_t height, size_t stride) {
+  for (size_t y = 1; y <= height; ++y) {
+    T *r = &cells[y * stride];
+    r[0]         = r[width];
+    r[width + 1] = r[1];
+  }
+  std::copy_n(&cells[height * stride], stride, &cells[0]);
+  std::copy_n(&cells[stride], stride, &cells[(height + 1) * stride]);
+}
+
+// Flat row‑major grid with a one‑cell ghost halo around the W×H interior.
+// Cell (x, y) is stored at cells[(y + 1) * stride + (x + 1)]; the halo holds
+// copies of the opposite edges (toroidal wrap) and is refreshed once per step,
+// so the stencil reads its 8 neighbours without branches or modulo arithmetic.
+struct Grid {
+  size_t width = 0, height = 0, stride = 0;
+  std::vector<Cell> cells;                   // (height + 2) × (width + 2)
+
+  Grid() = default;
+  Grid(size_t w, size_t h) : width(w), height(h), stride(w + 2), cells((w + 2) * (h + 2)) {}
+
+  Cell       *row(size_t y)       { return &cells[(y + 1) * stride + 1]; }
+  const Cell *row(size_t y) const { return &cells[(y + 1) * stride + 1]; }
+  Cell       &at(size_t x, size_t y)       { return row(y)[x]; }
+  const Cell &at(size_t x, size_t y) const { return row(y)[x]; }
+
+  void refresh_halo() { refresh_plane_halo(cells, width, height, stride); }
+};
+
+// Structure‑of‑arrays copy of a Grid: states and levels in two byte planes with
+// the same layout and halo, so a SIMD register holds 32/64 consecutive cells.
+struct Planes {
+  size_t width = 0, height = 0, stride = 0;
+  std::vector<uint8_t> state, level;         // (height + 2) × (width + 2) each
+
+  Planes() = default;
+  explicit Planes(const Grid &g)
+      : width(g.width), height(g.height), stride(g.stride), state(g.cells.size()), level(g.cells.size()) {
+    for (size_t i = 0; i < g.cells.size(); ++i) {
+      state[i] = static_cast<uint8_t>(g.cells[i].state);
+      level[i] = g.cells[i].level;
+    }
+  }
+
+  void to_grid(Grid &g) const {
+    for (size_t i = 0; i < g.cells.size(); ++i) g.cells[i] = {static_cast<CellState>(state[i]), level[i]};
+  }
+
+  size_t index(size_t x, size_t y) const { return (y + 1) * stride + x + 1; }
+
+  void refresh_halo() {
+    refresh_plane_halo(state, width, height, stride);
+    refresh_plane_halo(level, width, height, stride);
+  }
+};
 
 // ── CLI help ────────────────────────────────────────────────────────────────
 void print_help() {
@@ -93,6 +162,11 @@ void print_help() {
             << "  --weights <empty> <pred> <prey>  spawn weights (ints)\n"
             << "  --seed    <uint>     RNG seed (0 = random)\n"
             << "  --verify  <file>     compare final grid with reference file\n"
+            << "  --engine  <name>     update engine: seq (default), tbb, stdpar, simd or temporal\n"
+            << "  --simd    <isa>      rule kernel of the simd engine: scalar, avx2 or avx512 (default: best)\n"
+            << "  --depth   <uint>     generations per tile pass of the temporal engine (default 16)\n"
+            << "  --tile    <uint>     tile size of the temporal engine (default 512)\n"
+            << "  --benchmark <steps>  time the update alone and print cells/s\n"
             << "  --help              print this help\n\n";
 }
 
@@ -100,42 +174,50 @@ void print_help() {
 Grid initialize_grid(size_t width, size_t height,
                      int w_empty, int w_pred, int w_prey,
                      std::mt19937 &gen) {
-  Grid g(height, std::vector<Cell>(width));
+  Grid g(width, height);
   std::discrete_distribution<> pick({double(w_empty), double(w_pred), double(w_prey)});
-  for (auto &row : g)
-    for (auto &c : row) {
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x) {
+      Cell &c = g.at(x, y);
       c.state = static_cast<CellState>(pick(gen));
       c.level = (c.state == CellState::Empty) ? 0 : 50;
     }
+  g.refresh_halo();
   return g;
 }
 
 // ── Neighbour stats helper ──────────────────────────────────────────────────
+// Fixed‑size summary of the 8 neighbours, kept on the stack: the rules only need
+// counts, extrema and the sum of the predator levels — never the levels themselves.
+// With a single predator its level is max_predator_level; "every prey is stronger"
+// is min_prey_level > level.
 struct NeighborData {
-  std::vector<uint8_t> predator_levels;
-  std::vector<uint8_t> prey_levels;
-  uint8_t max_predator_level = 0;
-  uint8_t max_prey_level     = 0;
+  int     predators           = 0;
+  int     preys               = 0;
+  uint8_t max_predator_level  = 0;
+  uint8_t max_prey_level      = 0;
+  uint8_t min_prey_level      = 255;
   int     sum_predator_levels = 0;
   int     empty_neighbors     = 0;
 };
 
-NeighborData gather_neighbor_data(const Grid &g, int x, int y) {
+// `c` points at the centre cell inside a grid with a valid halo.
+NeighborData gather_neighbor_data(const Cell *c, ptrdiff_t stride) {
   NeighborData d;
-  const int H = g.size(), W = g[0].size();
   for (int dy = -1; dy <= 1; ++dy)
     for (int dx = -1; dx <= 1; ++dx) {
       if (dx == 0 && dy == 0) continue;            // skip self
-      const Cell &n = g[(y + dy + H) % H][(x + dx + W) % W];
+      const Cell &n = c[dy * stride + dx];
       switch (n.state) {
         case CellState::Predator:
-          d.predator_levels.push_back(n.level);
+          ++d.predators;
           d.max_predator_level = std::max(d.max_predator_level, n.level);
           d.sum_predator_levels += n.level;
           break;
         case CellState::Prey:
-          d.prey_levels.push_back(n.level);
+          ++d.preys;
           d.max_prey_level = std::max(d.max_prey_level, n.level);
+          d.min_prey_level = std::min(d.min_prey_level, n.level);
           break;
         case CellState::Empty:
           ++d.empty_neighbors;
@@ -145,57 +227,375 @@ NeighborData gather_neighbor_data(const Grid &g, int x, int y) {
   return d;
 }
 
-// ── Game rules update (sequential) ──────────────────────────────────────────
+// ── Game rules for one cell ─────────────────────────────────────────────────
+// `cp` points at the cell inside a grid with a valid halo; returns its next state.
+// Pure and allocation‑free, so every engine below can run it on any cell in any order.
+inline Cell evolve_cell(const Cell *cp, ptrdiff_t stride) {
+  const Cell &c = *cp;
+  const NeighborData nb = gather_neighbor_data(cp, stride);
+
+  if (c.state == CellState::Empty)
+    return (nb.preys >= 2)
+               ? Cell{CellState::Prey, static_cast<uint8_t>(std::min<int>(nb.max_prey_level + 1, 255))}
+               : c;
+
+  if (c.state == CellState::Prey) {
+    if (nb.predators == 1 && nb.max_predator_level > (c.level > 10 ? c.level - 10 : 0))
+      return {CellState::Empty, 0};
+    if (nb.preys > 2) return {CellState::Empty, 0};
+    if (nb.predators > 1 && c.level < nb.sum_predator_levels)
+      return {CellState::Predator,
+              static_cast<uint8_t>(std::min<int>(std::max(nb.max_predator_level, nb.max_prey_level) + 1, 255))};
+    if (nb.empty_neighbors == 0 || nb.preys > 3) return {CellState::Empty, 0};
+    return {CellState::Prey, static_cast<uint8_t>((nb.preys < 3 && c.level < 255) ? c.level + 1 : c.level)};
+  }
+
+  // Predator
+  if (nb.preys == 0) return {CellState::Empty, 0};
+  bool all_stronger = nb.min_prey_level > c.level;
+  return all_stronger ? Cell{CellState::Empty, 0}
+                      : Cell{CellState::Predator, static_cast<uint8_t>(std::min<int>(c.level + 1, 255))};
+}
+
+// ── Update engines ──────────────────────────────────────────────────────────
+// All engines read `cur` and write the interior of `next` (double buffering makes
+// the cells independent), then refresh the halo of `next` once.
+void update_rows(const Grid &cur, Grid &next, size_t y0, size_t y1) {
+  for (size_t y = y0; y < y1; ++y) {
+    const Cell *src = cur.row(y);
+    Cell *dst       = next.row(y);
+    for (size_t x = 0; x < cur.width; ++x) dst[x] = evolve_cell(src + x, cur.stride);
+  }
+}
+
 void update_grid_sequential(const Grid &cur, Grid &next) {
-  const size_t H = cur.size(), W = cur[0].size();
-  for (size_t y = 0; y < H; ++y)
-    for (size_t x = 0; x < W; ++x) {
-      const Cell &c = cur[y][x];
-      Cell &n       = next[y][x];
-      const NeighborData nb = gather_neighbor_data(cur, (int)x, (int)y);
-
-      if (c.state == CellState::Empty) {
-        n = (nb.prey_levels.size() >= 2)
-                ? Cell{CellState::Prey, static_cast<uint8_t>(std::min<int>(nb.max_prey_level + 1, 255))}
-                : c;
-        continue;
-      }
+  update_rows(cur, next, 0, cur.height);
+  next.refresh_halo();
+}
 
-      if (c.state == CellState::Prey) {
-        bool done = false;
-        if (nb.predator_levels.size() == 1 &&
-            nb.predator_levels[0] > (c.level > 10 ? c.level - 10 : 0)) {
-          n = {CellState::Empty, 0}; done = true;
-        }
-        if (!done && nb.prey_levels.size() > 2) { n = {CellState::Empty, 0}; done = true; }
-        if (!done && nb.predator_levels.size() > 1 && c.level < nb.sum_predator_levels) {
-          n = {CellState::Predator,
-                static_cast<uint8_t>(std::min<int>(std::max(nb.max_predator_level, nb.max_prey_level) + 1, 255))};
-          done = true;
-        }
-        if (!done && (nb.empty_neighbors == 0 || nb.prey_levels.size() > 3)) {
-          n = {CellState::Empty, 0}; done = true;
-        }
-        if (!done) {
-          n = {CellState::Prey,
-                static_cast<uint8_t>((nb.prey_levels.size() < 3 && c.level < 255) ? c.level + 1 : c.level)};
-        }
-        continue;
-      }
+// Row bands: each task owns whole rows, so no two tasks write the same cache line
+// except at the band edges.
+void update_grid_tbb(const Grid &cur, Grid &next) {
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, cur.height),
+                    [&](const tbb::blocked_range<size_t> &r) { update_rows(cur, next, r.begin(), r.end()); });
+  next.refresh_halo();
+}
 
-      if (c.state == CellState::Predator) {
-        if (nb.prey_levels.empty()) {
-          n = {CellState::Empty, 0};
-        } else {
-          bool all_stronger = std::all_of(nb.prey_levels.begin(), nb.prey_levels.end(),
-                                           [&](uint8_t l) { return l > c.level; });
-          n = all_stronger ? Cell{CellState::Empty, 0}
-                           : Cell{CellState::Predator, static_cast<uint8_t>(std::min<int>(c.level + 1, 255))};
-        }
-      }
+// One element per interior row, with the columns in the inner loop as in the TBB
+// engine: no index division per cell, and the halo columns are never visited.
+void update_grid_stdpar(const Grid &cur, Grid &next) {
+  std::vector<size_t> rows(cur.height);
+  std::iota(rows.begin(), rows.end(), size_t{0});
+  std::for_each(std::execution::par_unseq, rows.begin(), rows.end(),
+                [&](size_t y) { update_rows(cur, next, y, y + 1); });
+  next.refresh_halo();
+}
+
+// ── Branch‑free rule kernels over SoA planes ────────────────────────────────
+// Each kernel updates `width` cells of one row: `s`/`l` point at the first cell
+// of the row in the state/level planes (halo valid), `ns`/`nl` at the output,
+// which must not overlap the input: the SIMD kernels end a row with a full
+// vector that overlaps the previous one, recomputing a few cells.
+// Per cell, the 8 neighbours are reduced to counts, max/min levels and the
+// predator level sum; then every rule is evaluated for every cell and the
+// result is selected with masks instead of branches:
+//   Empty    → Prey (max prey + 1)                     if ≥2 preys
+//   Prey     → Empty                                   if 1 predator stronger than level‑10, or >2 preys
+//            → Predator (max(max pred, max prey) + 1)  if >1 predators and level < Σ predator levels
+//            → Empty                                   if no empty neighbour, or >3 preys
+//            → Prey (level + 1, saturated)             otherwise; ≤2 preys here, so it always grows
+//   Predator → Empty                                   if no prey, or every prey is stronger
+//            → Predator (level + 1, saturated)         otherwise
+// The predator level sum does not fit a byte: the kernels keep it modulo 256
+// plus an overflow flag, and "level < sum" becomes "overflow or level < sum".
+struct RuleKernel {
+  const char *name;
+  size_t lanes;        // cells per vector
+  void (*row)(const uint8_t *s, const uint8_t *l, ptrdiff_t stride, uint8_t *ns, uint8_t *nl, size_t width);
+};
+
+void rule_row_scalar(const uint8_t *s, const uint8_t *l, ptrdiff_t stride, uint8_t *ns, uint8_t *nl,
+                     size_t width) {
+  const ptrdiff_t off[8] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+  for (size_t x = 0; x < width; ++x) {
+    int npred = 0, nprey = 0, sum = 0;
+    uint8_t max_pred = 0, max_prey = 0, min_prey = 255;
+    for (ptrdiff_t o : off) {
+      const bool p = s[x + o] == 1, r = s[x + o] == 2;
+      const uint8_t pl = p ? l[x + o] : 0, rl = r ? l[x + o] : 0;
+      npred += p; nprey += r; sum += pl;
+      max_pred = std::max(max_pred, pl);
+      max_prey = std::max(max_prey, rl);
+      min_prey = std::min<uint8_t>(min_prey, r ? rl : 255);
+    }
+    const uint8_t L = l[x];
+    const auto inc = [](int v) { return static_cast<uint8_t>(std::min(v + 1, 255)); };
+
+    const bool birth  = nprey >= 2;
+    const bool die1   = (npred == 1 && max_pred > (L > 10 ? L - 10 : 0)) || nprey > 2;
+    const bool evolve = !die1 && npred > 1 && L < sum;
+    const bool die    = die1 || (!evolve && (npred + nprey == 8 || nprey > 3));
+    const bool starve = nprey == 0 || min_prey > L;
+
+    switch (s[x]) {
+      case 0:  ns[x] = birth ? 2 : 0; nl[x] = birth ? inc(max_prey) : L; break;
+      case 2:  ns[x] = die ? 0 : evolve ? 1 : 2;
+               nl[x] = die ? 0 : evolve ? inc(std::max(max_pred, max_prey)) : inc(L); break;
+      default: ns[x] = starve ? 0 : 1; nl[x] = starve ? 0 : inc(L); break;
+    }
+  }
+}
+
+#if defined(__x86_64__)
+// unsigned byte a > b, from the signed comparison with the sign bits flipped
+__attribute__((target("avx2"))) inline __m256i cmpgt_epu8_avx2(__m256i a, __m256i b) {
+  const __m256i bias = _mm256_set1_epi8(char(0x80));
+  return _mm256_cmpgt_epi8(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias));
+}
+
+__attribute__((target("avx2"))) void rule_row_avx2(const uint8_t *s, const uint8_t *l, ptrdiff_t stride,
+                                                    uint8_t *ns, uint8_t *nl, size_t width) {
+  const ptrdiff_t off[8] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+  const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi8(-1);
+  const __m256i one = _mm256_set1_epi8(1), two = _mm256_set1_epi8(2), three = _mm256_set1_epi8(3);
+  const __m256i eight = _mm256_set1_epi8(8), ten = _mm256_set1_epi8(10);
+  if (width < 32) return rule_row_scalar(s, l, stride, ns, nl, width);
+  for (size_t x = 0; x < width; x += 32) {
+    x = std::min(x, width - 32);   // the last block overlaps the previous one
+    __m256i npred = zero, nprey = zero, sum = zero, over = zero;
+    __m256i max_pred = zero, max_prey = zero, min_prey = ones;
+    for (ptrdiff_t o : off) {
+      const __m256i S = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + x + o));
+      const __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(l + x + o));
+      const __m256i p = _mm256_cmpeq_epi8(S, one), r = _mm256_cmpeq_epi8(S, two);
+      const __m256i pl = _mm256_and_si256(V, p), rl = _mm256_and_si256(V, r);
+      npred    = _mm256_sub_epi8(npred, p);
+      nprey    = _mm256_sub_epi8(nprey, r);
+      max_pred = _mm256_max_epu8(max_pred, pl);
+      max_prey = _mm256_max_epu8(max_prey, rl);
+      min_prey = _mm256_min_epu8(min_prey, _mm256_or_si256(rl, _mm256_andnot_si256(r, ones)));
+      const __m256i t = _mm256_add_epi8(sum, pl);
+      over = _mm256_or_si256(over, cmpgt_epu8_avx2(pl, t));     // carry out of the byte
+      sum  = t;
     }
+    const __m256i S = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + x));
+    const __m256i L = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(l + x));
+    const __m256i L1 = _mm256_adds_epu8(L, one);
+
+    const __m256i birth = _mm256_cmpgt_epi8(nprey, one);
+    const __m256i die1 = _mm256_or_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(npred, one), cmpgt_epu8_avx2(max_pred, _mm256_subs_epu8(L, ten))),
+        _mm256_cmpgt_epi8(nprey, two));
+    const __m256i evolve = _mm256_andnot_si256(
+        die1, _mm256_and_si256(_mm256_cmpgt_epi8(npred, one), _mm256_or_si256(over, cmpgt_epu8_avx2(sum, L))));
+    const __m256i crowded =
+        _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_add_epi8(npred, nprey), eight), _mm256_cmpgt_epi8(nprey, three));
+    const __m256i die = _mm256_or_si256(die1, _mm256_andnot_si256(evolve, crowded));
+    const __m256i starve = _mm256_or_si256(_mm256_cmpeq_epi8(nprey, zero), cmpgt_epu8_avx2(min_prey, L));
+
+    // empty cells
+    __m256i out_s = _mm256_and_si256(birth, two);
+    __m256i out_l = _mm256_blendv_epi8(L, _mm256_adds_epu8(max_prey, one), birth);
+    // prey cells
+    const __m256i is_prey = _mm256_cmpeq_epi8(S, two);
+    const __m256i prey_s = _mm256_andnot_si256(die, _mm256_blendv_epi8(two, one, evolve));
+    const __m256i prey_l = _mm256_andnot_si256(
+        die, _mm256_blendv_epi8(L1, _mm256_adds_epu8(_mm256_max_epu8(max_pred, max_prey), one), evolve));
+    out_s = _mm256_blendv_epi8(out_s, prey_s, is_prey);
+    out_l = _mm256_blendv_epi8(out_l, prey_l, is_prey);
+    // predator cells
+    const __m256i is_pred = _mm256_cmpeq_epi8(S, one);
+    out_s = _mm256_blendv_epi8(out_s, _mm256_andnot_si256(starve, one), is_pred);
+    out_l = _mm256_blendv_epi8(out_l, _mm256_andnot_si256(starve, L1), is_pred);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ns + x), out_s);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(nl + x), out_l);
+  }
+}
+
+// The same kernel with 64 lanes; the masks live in k registers.
+__attribute__((target("avx512f,avx512bw"))) void rule_row_avx512(const uint8_t *s, const uint8_t *l,
+                                                                  ptrdiff_t stride, uint8_t *ns, uint8_t *nl,
+                                                                  size_t width) {
+  const ptrdiff_t off[8] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+  const __m512i zero = _mm512_setzero_si512(), ones = _mm512_set1_epi8(-1);
+  const __m512i one = _mm512_set1_epi8(1), two = _mm512_set1_epi8(2), three = _mm512_set1_epi8(3);
+  const __m512i eight = _mm512_set1_epi8(8), ten = _mm512_set1_epi8(10);
+  if (width < 64) return rule_row_scalar(s, l, stride, ns, nl, width);
+  for (size_t x = 0; x < width; x += 64) {
+    x = std::min(x, width - 64);   // the last block overlaps the previous one
+    __m512i npred = zero, nprey = zero, sum = zero;
+    __m512i max_pred = zero, max_prey = zero, min_prey = ones;
+    __mmask64 over = 0;
+    for (ptrdiff_t o : off) {
+      const __m512i S = _mm512_loadu_si512(s + x + o);
+      const __m512i V = _mm512_loadu_si512(l + x + o);
+      const __mmask64 p = _mm512_cmpeq_epi8_mask(S, one), r = _mm512_cmpeq_epi8_mask(S, two);
+      const __m512i pl = _mm512_maskz_mov_epi8(p, V);
+      npred    = _mm512_mask_add_epi8(npred, p, npred, one);
+      nprey    = _mm512_mask_add_epi8(nprey, r, nprey, one);
+      max_pred = _mm512_max_epu8(max_pred, pl);
+      max_prey = _mm512_mask_max_epu8(max_prey, r, max_prey, V);
+      min_prey = _mm512_mask_min_epu8(min_prey, r, min_prey, V);
+      const __m512i t = _mm512_add_epi8(sum, pl);
+      over |= _mm512_cmplt_epu8_mask(t, pl);                    // carry out of the byte
+      sum = t;
+    }
+    const __m512i S = _mm512_loadu_si512(s + x);
+    const __m512i L = _mm512_loadu_si512(l + x);
+    const __m512i L1 = _mm512_adds_epu8(L, one);
+
+    const __mmask64 birth = _mm512_cmpgt_epu8_mask(nprey, one);
+    const __mmask64 die1 =
+        (_mm512_cmpeq_epi8_mask(npred, one) & _mm512_cmpgt_epu8_mask(max_pred, _mm512_subs_epu8(L, ten))) |
+        _mm512_cmpgt_epu8_mask(nprey, two);
+    const __mmask64 evolve = ~die1 & _mm512_cmpgt_epu8_mask(npred, one) & (over | _mm512_cmpgt_epu8_mask(sum, L));
+    const __mmask64 crowded =
+        _mm512_cmpeq_epi8_mask(_mm512_add_epi8(npred, nprey), eight) | _mm512_cmpgt_epu8_mask(nprey, three);
+    const __mmask64 die = die1 | (~evolve & crowded);
+    const __mmask64 starve = _mm512_cmpeq_epi8_mask(nprey, zero) | _mm512_cmpgt_epu8_mask(min_prey, L);
+
+    // empty cells
+    __m512i out_s = _mm512_maskz_mov_epi8(birth, two);
+    __m512i out_l = _mm512_mask_blend_epi8(birth, L, _mm512_adds_epu8(max_prey, one));
+    // prey cells
+    const __mmask64 is_prey = _mm512_cmpeq_epi8_mask(S, two);
+    const __m512i prey_s = _mm512_maskz_mov_epi8(~die, _mm512_mask_blend_epi8(evolve, two, one));
+    const __m512i prey_l = _mm512_maskz_mov_epi8(
+        ~die, _mm512_mask_blend_epi8(evolve, L1, _mm512_adds_epu8(_mm512_max_epu8(max_pred, max_prey), one)));
+    out_s = _mm512_mask_blend_epi8(is_prey, out_s, prey_s);
+    out_l = _mm512_mask_blend_epi8(is_prey, out_l, prey_l);
+    // predator cells
+    const __mmask64 is_pred = _mm512_cmpeq_epi8_mask(S, one);
+    out_s = _mm512_mask_blend_epi8(is_pred, out_s, _mm512_maskz_mov_epi8(~starve, one));
+    out_l = _mm512_mask_blend_epi8(is_pred, out_l, _mm512_maskz_mov_epi8(~starve, L1));
+
+    _mm512_storeu_si512(ns + x, out_s);
+    _mm512_storeu_si512(nl + x, out_l);
+  }
+}
+#endif  // defined(__x86_64__)
+
+// All the kernels supported by the current CPU, from the scalar one to the widest.
+std::vector<RuleKernel> supported_rule_kernels() {
+  std::vector<RuleKernel> kernels = {{"scalar", 1, rule_row_scalar}};
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", 32, rule_row_avx2});
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    kernels.push_back({"avx512", 64, rule_row_avx512});
+#endif
+  return kernels;
+}
+
+RuleKernel rule_kernel = supported_rule_kernels().back();   // --simd overrides it
+
+// SoA engines advance the world by up to `steps` generations per call, and
+// return how many they did.
+
+// One generation per call, over TBB row bands like the AoS TBB engine.
+size_t update_planes_simd(const Planes &cur, Planes &next, size_t /*steps*/) {
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, cur.height), [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t y = r.begin(); y < r.end(); ++y) {
+      const size_t i = cur.index(0, y);
+      rule_kernel.row(&cur.state[i], &cur.level[i], cur.stride, &next.state[i], &next.level[i], cur.width);
+    }
+  });
+  next.refresh_halo();
+  return 1;
+}
+
+// ── Temporal blocking ───────────────────────────────────────────────────────
+// Overlapped‑halo tiles: each tile×tile block is loaded together with a halo
+// `depth` cells wide (wrapping around the torus) into a small buffer that stays
+// in cache, advanced `depth` generations there — generation k is computed on a
+// region one cell per side narrower than generation k‑1 — and only its centre
+// is written back. The big planes are then streamed once every `depth`
+// generations instead of once per generation, at the price of recomputing the
+// overlaps between neighbouring tiles.
+size_t temporal_depth = 16;    // --depth
+size_t temporal_tile  = 512;   // --tile
+
+struct TileBuffer {
+  std::vector<uint8_t> state[2], level[2];   // ping‑pong, (tile + 2·depth)² each
+};
+
+// Copy `count` cells of row y, starting at column x (both wrapped), to dst.
+void load_wrapped(const Planes &src, ptrdiff_t x, ptrdiff_t y, size_t count, uint8_t *ds, uint8_t *dl) {
+  const ptrdiff_t W = src.width, H = src.height;
+  y = (y % H + H) % H;
+  x = (x % W + W) % W;
+  while (count > 0) {
+    const size_t run = std::min<size_t>(count, W - x);
+    const size_t i = src.index(x, y);
+    std::copy_n(&src.state[i], run, ds);
+    std::copy_n(&src.level[i], run, dl);
+    ds += run; dl += run; count -= run; x = 0;
+  }
 }
 
+void advance_tile(const Planes &cur, Planes &next, size_t x0, size_t y0, size_t tw, size_t th, size_t depth,
+                  TileBuffer &buf) {
+  const size_t lw = tw + 2 * depth, lh = th + 2 * depth;
+  for (int b = 0; b < 2; ++b) {
+    if (buf.state[b].size() < lw * lh) { buf.state[b].resize(lw * lh); buf.level[b].resize(lw * lh); }
+  }
+
+  for (size_t ly = 0; ly < lh; ++ly)
+    load_wrapped(cur, ptrdiff_t(x0) - ptrdiff_t(depth), ptrdiff_t(y0 + ly) - ptrdiff_t(depth), lw,
+                 &buf.state[0][ly * lw], &buf.level[0][ly * lw]);
+
+  for (size_t k = 1; k <= depth; ++k) {
+    const uint8_t *s = buf.state[(k - 1) % 2].data(), *l = buf.level[(k - 1) % 2].data();
+    uint8_t *ns = buf.state[k % 2].data(), *nl = buf.level[k % 2].data();
+    for (size_t ly = k; ly < lh - k; ++ly) {
+      const size_t i = ly * lw + k;
+      rule_kernel.row(s + i, l + i, lw, ns + i, nl + i, lw - 2 * k);
+    }
+  }
+
+  const uint8_t *s = buf.state[depth % 2].data(), *l = buf.level[depth % 2].data();
+  for (size_t y = 0; y < th; ++y) {
+    const size_t i = (y + depth) * lw + depth, o = next.index(x0, y0 + y);
+    std::copy_n(s + i, tw, &next.state[o]);
+    std::copy_n(l + i, tw, &next.level[o]);
+  }
+}
+
+size_t update_planes_temporal(const Planes &cur, Planes &next, size_t steps) {
+  static tbb::enumerable_thread_specific<TileBuffer> buffers;
+  const size_t depth = std::min(steps, temporal_depth);
+  // round the tile up so that its first generation, 2·(depth − 1) cells wider,
+  // is a whole number of vectors
+  const size_t lanes = rule_kernel.lanes;
+  const size_t B = (temporal_tile + 2 * depth - 2 + lanes - 1) / lanes * lanes - (2 * depth - 2);
+  const size_t tiles_x = (cur.width + B - 1) / B, tiles_y = (cur.height + B - 1) / B;
+  tbb::parallel_for(tbb::blocked_range2d<size_t>(0, tiles_y, 0, tiles_x), [&](const tbb::blocked_range2d<size_t> &r) {
+    TileBuffer &buf = buffers.local();
+    for (size_t ty = r.rows().begin(); ty < r.rows().end(); ++ty)
+      for (size_t tx = r.cols().begin(); tx < r.cols().end(); ++tx) {
+        const size_t x0 = tx * B, y0 = ty * B;
+        advance_tile(cur, next, x0, y0, std::min(B, cur.width - x0), std::min(B, cur.height - y0), depth, buf);
+      }
+  });
+  next.refresh_halo();
+  return depth;
+}
+
+struct Engine {
+  const char *name;    // --engine value
+  const char *label;   // printed with the elapsed time
+  void (*update)(const Grid &, Grid &);                            // AoS engines …
+  size_t (*update_planes)(const Planes &, Planes &, size_t steps); // … or SoA engines
+};
+constexpr Engine ENGINES[] = {
+  {"seq",      "Sequential",        update_grid_sequential, nullptr},
+  {"tbb",      "TBB",               update_grid_tbb,        nullptr},
+  {"stdpar",   "std::execution",    update_grid_stdpar,     nullptr},
+  {"simd",     "SIMD",              nullptr,                update_planes_simd},
+  {"temporal", "Temporal blocking", nullptr,                update_planes_temporal},
+};
+
 // ── Sprite loader ───────────────────────────────────────────────────────────
 struct Sprite { int w, h; std::vector<uint8_t> rgba; };
 Sprite load_png_sprite(const char *file) {
@@ -221,12 +621,12 @@ inline void blit_sprite(const Sprite &sp, std::vector<uint8_t> &img, int W, int
 void save_frame_as_gif(const Grid &g, GifWriter &wr,
                        const Sprite &fox, const Sprite &bunny, const Sprite &grass) {
   if constexpr (!SAVE_GRIDS) return;
-  const int cellsW = g[0].size(), cellsH = g.size();
+  const int cellsW = g.width, cellsH = g.height;
   const int W = cellsW * TILE, H = cellsH * TILE;
   std::vector<uint8_t> img(W * H * 4);
   for (int gy = 0; gy < cellsH; ++gy)
     for (int gx = 0; gx < cellsW; ++gx) {
-      switch (g[gy][gx].state) {
+      switch (g.at(gx, gy).state) {
         case CellState::Empty:    blit_sprite(grass, img, W, gx, gy); break;
         case CellState::Prey:     blit_sprite(bunny, img, W, gx, gy); break;
         case CellState::Predator: blit_sprite(fox,   img, W, gx, gy); break;
@@ -238,19 +638,27 @@ void save_frame_as_gif(const Grid &g, GifWriter &wr,
 // ── Grid I/O for verification ──────────────────────────────────────────────
 void save_grid_to_file(const Grid &g, const std::string &fn) {
   std::ofstream o(fn);
-  for (auto &r : g) { for (auto &c : r) o << int(c.state) << ' ' << int(c.level) << ' '; o << '\n'; }
+  for (size_t y = 0; y < g.height; ++y) {
+    for (size_t x = 0; x < g.width; ++x) o << int(g.at(x, y).state) << ' ' << int(g.at(x, y).level) << ' ';
+    o << '\n';
+  }
 }
 
 bool load_grid_from_file(Grid &g, const std::string &fn) {
   std::ifstream i(fn); if (!i) { std::cerr << "Cannot open " << fn << '\n'; return false; }
-  for (auto &r : g) for (auto &c : r) { int s, l; i >> s >> l; if (i.fail()) return false; c.state = (CellState)s; c.level = (uint8_t)l; }
+  for (size_t y = 0; y < g.height; ++y)
+    for (size_t x = 0; x < g.width; ++x) {
+      int s, l; i >> s >> l; if (i.fail()) return false;
+      g.at(x, y) = {(CellState)s, (uint8_t)l};
+    }
+  g.refresh_halo();
   return true;
 }
 
 bool compare_grids(const Grid &a, const Grid &b) {
-  for (size_t y = 0; y < a.size(); ++y)
-    for (size_t x = 0; x < a[0].size(); ++x)
-      if (a[y][x].state != b[y][x].state || a[y][x].level != b[y][x].level) return false;
+  for (size_t y = 0; y < a.height; ++y)
+    for (size_t x = 0; x < a.width; ++x)
+      if (a.at(x, y).state != b.at(x, y).state || a.at(x, y).level != b.at(x, y).level) return false;
   return true;
 }
 
@@ -258,7 +666,8 @@ bool compare_grids(const Grid &a, const Grid &b) {
 int main(int argc, char *argv[]) {
   // — Defaults & CLI --------------------------------------------------------
   size_t Wcells = 100, Hcells = 100; unsigned seed = 0; bool seed_set = false;
-  int w_e = 5, w_p = 1, w_r = 1; std::string verify_fn;
+  int w_e = 5, w_p = 1, w_r = 1; std::string verify_fn; size_t bench_steps = 0;
+  const Engine *engine = &ENGINES[0];
 
   for (int i = 1; i < argc; ++i) {
     std::string a = argv[i];
@@ -268,6 +677,24 @@ int main(int argc, char *argv[]) {
     else if (a == "--width" && i + 1 < argc) { Wcells = std::stoul(argv[++i]); }
     else if (a == "--height" && i + 1 < argc) { Hcells = std::stoul(argv[++i]); }
     else if (a == "--verify" && i + 1 < argc) { verify_fn = argv[++i]; }
+    else if (a == "--benchmark" && i + 1 < argc) { bench_steps = std::stoul(argv[++i]); }
+    else if (a == "--engine" && i + 1 < argc) {
+      const std::string name = argv[++i];
+      auto e = std::find_if(std::begin(ENGINES), std::end(ENGINES), [&](const Engine &c) { return name == c.name; });
+      if (e == std::end(ENGINES)) {
+        std::cerr << "Unknown engine " << name << ", use seq, tbb, stdpar, simd or temporal\n"; return 1;
+      }
+      engine = e;
+    }
+    else if (a == "--depth" && i + 1 < argc) { temporal_depth = std::max<size_t>(std::stoul(argv[++i]), 1); }
+    else if (a == "--tile" && i + 1 < argc) { temporal_tile = std::max<size_t>(std::stoul(argv[++i]), 1); }
+    else if (a == "--simd" && i + 1 < argc) {
+      const std::string name = argv[++i];
+      const auto kernels = supported_rule_kernels();
+      auto k = std::find_if(kernels.begin(), kernels.end(), [&](const RuleKernel &c) { return name == c.name; });
+      if (k == kernels.end()) { std::cerr << "Rule kernel " << name << " not supported on this CPU\n"; return 1; }
+      rule_kernel = *k;
+    }
     else { std::cerr << "Unknown/invalid option " << a << '\n'; return 1; }
   }
 
@@ -280,7 +707,38 @@ int main(int argc, char *argv[]) {
 
   // — Initialise world ------------------------------------------------------
   Grid g = initialize_grid(Wcells, Hcells, w_e, w_p, w_r, rng);
-  Grid next = g;
+
+  // SoA engines keep the world in byte planes; the Grid is rebuilt from them
+  // only for the GIF frames and at the end.
+  const bool soa = engine->update_planes != nullptr;
+  Grid next = soa ? Grid() : g;
+  Planes p, pnext;
+  if (soa) { p = Planes(g); pnext = p; }
+  auto step = [&](size_t steps) -> size_t {   // advance up to `steps` generations
+    if (!soa) { engine->update(g, next); std::swap(g, next); return 1; }
+    const size_t done = engine->update_planes(p, pnext, steps);
+    std::swap(p, pnext);
+    return done;
+  };
+  std::string label = engine->label;
+  if (soa) label += std::string(" (") + rule_kernel.name + ")";
+  if (engine->update_planes == update_planes_temporal)
+    label += " depth " + std::to_string(temporal_depth) + ", tile " + std::to_string(temporal_tile);
+  // a GIF frame is written after every generation, so only the benchmark runs passes of --depth generations
+  if (SAVE_GRIDS && bench_steps == 0 && engine->update_planes == update_planes_temporal && temporal_depth > 1)
+    std::cerr << "Warning: SAVE_GRIDS advances the grid one generation per GIF frame, the temporal engine runs at"
+                 " depth 1 instead of " << temporal_depth << "; set SAVE_GRIDS = false or use --benchmark\n";
+
+  // — Benchmark: update only, no GIF and no verification ---------------------
+  if (bench_steps > 0) {
+    const auto b0 = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < bench_steps;) it += step(bench_steps - it);
+    const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - b0).count();
+    std::cout << label << " benchmark " << bench_steps << " steps on " << Wcells << "×" << Hcells
+              << " cells: " << s << " s, "
+              << double(Wcells) * Hcells * bench_steps / s / 1e6 << " Mcells/s\n";
+    return 0;
+  }
 
   // — Prepare GIF -----------------------------------------------------------
   GifWriter wr = {};
@@ -292,18 +750,19 @@ int main(int argc, char *argv[]) {
   // — Simulation loop -------------------------------------------------------
   constexpr size_t ITER = 50;
   const auto t0 = std::chrono::high_resolution_clock::now();
-  for (size_t it = 0; it < ITER; ++it) {
-    update_grid_sequential(g, next);
-    save_frame_as_gif(g, wr, fox, bunny, grass);
-    std::swap(g, next);
+  for (size_t it = 0; it < ITER;) {
+    if (soa && SAVE_GRIDS) p.to_grid(g);
+    save_frame_as_gif(g, wr, fox, bunny, grass);   // the frame before the update
+    it += step(SAVE_GRIDS ? 1 : ITER - it);        // one generation per GIF frame
   }
+  if (soa) p.to_grid(g);
   const auto t1 = std::chrono::high_resolution_clock::now();
-  std::cout << "Sequential elapsed " << std::chrono::duration<double>(t1 - t0).count() << " s\n";
+  std::cout << label << " elapsed " << std::chrono::duration<double>(t1 - t0).count() << " s\n";
   if constexpr (SAVE_GRIDS) { GifEnd(&wr); std::cout << "Saved simulation.gif\n"; }
 
   // — Verification or reference write --------------------------------------
   if (!verify_fn.empty()) {
-    Grid ref(Hcells, std::vector<Cell>(Wcells));
+    Grid ref(Wcells, Hcells);
     if (!load_grid_from_file(ref, verify_fn)) return 1;
     if (compare_grids(g, ref)) {
       std::cout << "Verification OK\n";
@@ -26,6 +26,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>.
 #include <stdexcept>
 #include <vector>
 
+#include "resample.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -174,66 +176,16 @@ struct Image {
 
 bool verbose = true;
 
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
+// make a scaled copy of an image, using the separable resampling engine
+Image scale(Image const& src, int width, int height, Filter filter = Filter::Bilinear) {
   if (width == src.width_ and height == src.height_) {
     // if the dimensions are the same, return a copy of the image
     return src;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
   auto start = std::chrono::steady_clock::now();
 
-  for (int y = 0; y < height; ++y) {
-    // map the row of the scaled image to the nearest rows of the original image
-    float yp = static_cast<float>(y) * src.height_ / height;
-    int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
-    int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
-
-    // interpolate between y0 and y1
-    float wy0 = yp - y0;
-    float wy1 = y1 - yp;
-    // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-    if (y0 == y1) {
-      wy0 = 1.f;
-      wy1 = 1.f;
-    }
-    float dy = wy0 + wy1;
-
-    for (int x = 0; x < width; ++x) {
-      int p = (y * out.width_ + x) * out.channels_;
-
-      // map the column of the scaled image to the nearest columns of the original image
-      float xp = static_cast<float>(x) * src.width_ / width;
-      int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
-      int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
-
-      // interpolate between x0 and x1
-      float wx0 = xp - x0;
-      float wx1 = x1 - xp;
-      // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-      if (x0 == x1) {
-        wx0 = 1.f;
-        wx1 = 1.f;
-      }
-      float dx = wx0 + wx1;
-
-      // bi-linear interpolation of all channels
-      int p00 = (y0 * src.width_ + x0) * src.channels_;
-      int p10 = (y1 * src.width_ + x0) * src.channels_;
-      int p01 = (y0 * src.width_ + x1) * src.channels_;
-      int p11 = (y1 * src.width_ + x1) * src.channels_;
-
-      for (int c = 0; c < src.channels_; ++c) {
-        out.data_[p + c] =
-            static_cast<unsigned char>(std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                                                   src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
-                                                  (dx * dy)));
-      }
-    }
-  }
+  Image out = Resampler::get(src.width_, src.height_, width, height, filter)->apply(src);
 
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
@@ -16,7 +16,10 @@ You should have received a copy of the GNU General Public License along
 with this program. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -31,6 +34,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>.
 #include <unistd.h>
 #endif
 
+#include "resample.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -167,94 +172,101 @@ struct Image {
       height = max_height;
     }
 
+    // decimal representation of each colour component, formatted once
+    struct Component {
+      char text[3];
+      int size;
+    };
+    static const auto components = [] {
+      std::array<Component, 256> components;
+      for (int value = 0; value < 256; ++value) {
+        components[value].size = fmt::format_to_n(components[value].text, 3, "{}", value).size;
+      }
+      return components;
+    }();
+
+    // append the escape sequence that sets the foreground ("38") or background ("48") colour
+    auto set_color = [](char* out, const char* layer, const unsigned char* pixel) {
+      out = std::copy_n("\x1b[", 2, out);
+      out = std::copy_n(layer, 2, out);
+      out = std::copy_n(";2", 2, out);
+      for (int c = 0; c < 3; ++c) {
+        *out++ = ';';
+        out = std::copy_n(components[pixel[c]].text, components[pixel[c]].size, out);
+      }
+      *out++ = 'm';
+      return out;
+    };
+
+    // build the whole frame in a single buffer: each cell needs at most two 19-byte colour codes and the 3-byte
+    // block, and each line ends with a 4-byte reset and a newline
+    const char block[] = "▀";
+    std::vector<char> buffer((height + 1) / 2 * (width * (2 * 19 + 3) + 5));
+    char* out = buffer.data();
+
     // two blocks per line
     for (int j = 0; j < height; j += 2) {
       int y1 = j * height_ / height;
       int y2 = (j + 1) * height_ / height;
+      // the colours are reset at the end of each line; skip the codes that would set the same colours again
+      int last_fg = -1;
+      int last_bg = -1;
       // one block per column
       for (int i = 0; i < width; ++i) {
         int x = i * width_ / width;
-        int p = (y1 * width_ + x) * channels_;
-        int r = data_[p];
-        int g = data_[p + 1];
-        int b = data_[p + 2];
-        auto style = fmt::fg(fmt::rgb(r, g, b));
+        const unsigned char* top = data_ + (y1 * width_ + x) * channels_;
+        int fg = (top[0] << 16) | (top[1] << 8) | top[2];
+        if (fg != last_fg) {
+          out = set_color(out, "38", top);
+          last_fg = fg;
+        }
         if (y2 < height_) {
-          p = (y2 * width_ + x) * channels_;
-          r = data_[p];
-          g = data_[p + 1];
-          b = data_[p + 2];
-          style |= fmt::bg(fmt::rgb(r, g, b));
+          const unsigned char* bottom = data_ + (y2 * width_ + x) * channels_;
+          int bg = (bottom[0] << 16) | (bottom[1] << 8) | bottom[2];
+          if (bg != last_bg) {
+            out = set_color(out, "48", bottom);
+            last_bg = bg;
+          }
+        }
+        out = std::copy_n(block, sizeof(block) - 1, out);
+      }
+      out = std::copy_n("\x1b[0m\n", 5, out);
+    }
+
+    // write the frame with a single system call, after any output still buffered by std::cout
+    std::cout.flush();
+    const char* data = buffer.data();
+    size_t size = out - buffer.data();
+#ifdef __linux__
+    while (size > 0) {
+      ssize_t written = ::write(STDOUT_FILENO, data, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
         }
-        std::cout << fmt::format(style, "▀");
+        break;
       }
-      std::cout << '\n';
+      data += written;
+      size -= written;
     }
+#else
+    std::cout.write(data, size);
+#endif
   }
 };
 
 bool verbose = true;
 
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
+// make a scaled copy of an image, using the separable resampling engine
+Image scale(Image const& src, int width, int height, Filter filter = Filter::Bilinear) {
   if (width == src.width_ and height == src.height_) {
     // if the dimensions are the same, return a copy of the image
     return src;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
   auto start = std::chrono::steady_clock::now();
 
-  for (int y = 0; y < height; ++y) {
-    // map the row of the scaled image to the nearest rows of the original image
-    float yp = static_cast<float>(y) * src.height_ / height;
-    int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
-    int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
-
-    // interpolate between y0 and y1
-    float wy0 = yp - y0;
-    float wy1 = y1 - yp;
-    // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-    if (y0 == y1) {
-      wy0 = 1.f;
-      wy1 = 1.f;
-    }
-    float dy = wy0 + wy1;
-
-    for (int x = 0; x < width; ++x) {
-      int p = (y * out.width_ + x) * out.channels_;
-
-      // map the column of the scaled image to the nearest columns of the original image
-      float xp = static_cast<float>(x) * src.width_ / width;
-      int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
-      int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
-
-      // interpolate between x0 and x1
-      float wx0 = xp - x0;
-      float wx1 = x1 - xp;
-      // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-      if (x0 == x1) {
-        wx0 = 1.f;
-        wx1 = 1.f;
-      }
-      float dx = wx0 + wx1;
-
-      // bi-linear interpolation of all channels
-      int p00 = (y0 * src.width_ + x0) * src.channels_;
-      int p10 = (y1 * src.width_ + x0) * src.channels_;
-      int p01 = (y0 * src.width_ + x1) * src.channels_;
-      int p11 = (y1 * src.width_ + x1) * src.channels_;
-
-      for (int c = 0; c < src.channels_; ++c) {
-        out.data_[p + c] =
-            static_cast<unsigned char>(std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                                                   src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
-                                                  (dx * dy)));
-      }
-    }
-  }
+  Image out = Resampler::get(src.width_, src.height_, width, height, filter)->apply(src);
 
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
@@ -29,6 +29,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>.
 
 #include <tbb/tbb.h>
 
+#include "resample.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -179,71 +181,55 @@ struct Image {
 
 bool verbose = true;
 
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
+// images with fewer pixels than this are processed by a single task each, running the kernels sequentially, and are
+// grouped in batches of about batch_pixels pixels; the larger images are processed one at a time, and each kernel
+// runs in parallel over the rows of the image
+constexpr int small_image_pixels = 256 * 256;
+constexpr int batch_pixels = 1024 * 1024;
+
+bool is_small(Image const& img) {
+  return img.width_ * img.height_ < small_image_pixels;
+}
+
+// run body(y) for each row in [0, rows): sequentially for the images processed in a batch, in parallel otherwise;
+// the decision is taken once per input image, so all the kernels that process it agree with the batching
+template <typename Body>
+void for_each_row(bool batched, int rows, Body const& body) {
+  if (batched) {
+    for (int y = 0; y < rows; ++y) {
+      body(y);
+    }
+  } else {
+    tbb::parallel_for<int>(0, rows, 1, body);
+  }
+}
+
+// loop policy for the resampler: the rows of the images processed in a batch are resampled by a single task, those
+// of the other images are split among the tasks
+struct BatchedRows {
+  bool batched;
+
+  template <typename Body>
+  void operator()(const char* kernel, int rows, int cols, Body const& body) const {
+    if (batched) {
+      body(0, rows);
+    } else {
+      tbb::parallel_for(tbb::blocked_range<int>(0, rows),
+                        [&](tbb::blocked_range<int> const& range) { body(range.begin(), range.end()); });
+    }
+  }
+};
+
+// make a scaled copy of an image, using the separable resampling engine
+Image scale(Image const& src, int width, int height, bool batched, Filter filter = Filter::Bilinear) {
   if (width == src.width_ and height == src.height_) {
     // if the dimensions are the same, return a copy of the image
     return src;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
   auto start = std::chrono::steady_clock::now();
 
-  tbb::parallel_for(
-      tbb::blocked_range2d<int, int>{0, height, 16, 0, width, 16},
-      [&](tbb::blocked_range2d<int, int> const& range) {
-        for (int y = range.rows().begin(); y < range.rows().end(); ++y) {
-          // map the row of the scaled image to the nearest rows of the original image
-          float yp = static_cast<float>(y) * src.height_ / height;
-          int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
-          int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
-
-          // interpolate between y0 and y1
-          float wy0 = yp - y0;
-          float wy1 = y1 - yp;
-          // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-          if (y0 == y1) {
-            wy0 = 1.f;
-            wy1 = 1.f;
-          }
-          float dy = wy0 + wy1;
-
-          for (int x = range.cols().begin(); x < range.cols().end(); ++x) {
-            int p = (y * out.width_ + x) * out.channels_;
-
-            // map the column of the scaled image to the nearest columns of the original image
-            float xp = static_cast<float>(x) * src.width_ / width;
-            int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
-            int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
-
-            // interpolate between x0 and x1
-            float wx0 = xp - x0;
-            float wx1 = x1 - xp;
-            // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-            if (x0 == x1) {
-              wx0 = 1.f;
-              wx1 = 1.f;
-            }
-            float dx = wx0 + wx1;
-
-            // bi-linear interpolation of all channels
-            int p00 = (y0 * src.width_ + x0) * src.channels_;
-            int p10 = (y1 * src.width_ + x0) * src.channels_;
-            int p01 = (y0 * src.width_ + x1) * src.channels_;
-            int p11 = (y1 * src.width_ + x1) * src.channels_;
-
-            for (int c = 0; c < src.channels_; ++c) {
-              out.data_[p + c] = static_cast<unsigned char>(
-                  std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                              src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
-                             (dx * dy)));
-            }
-          }
-        }
-      },
-      tbb::simple_partitioner());
+  Image out = Resampler::get(src.width_, src.height_, width, height, filter)->apply(src, BatchedRows{batched});
 
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
@@ -255,7 +241,7 @@ Image scale(Image const& src, int width, int height) {
 }
 
 // copy a source image into a target image, cropping any parts that fall outside the target image
-void write_to(Image const& src, Image& dst, int x, int y) {
+void write_to(Image const& src, Image& dst, int x, int y, bool batched) {
   // copying to an image with a different number of channels is not supported
   assert(src.channels_ == dst.channels_);
 
@@ -284,7 +270,7 @@ void write_to(Image const& src, Image& dst, int x, int y) {
 
   auto start = std::chrono::steady_clock::now();
 
-  tbb::parallel_for<int>(0, y_height, 1, [&](int y) {
+  for_each_row(batched, y_height, [&](int y) {
     int src_p = ((src_y_from + y) * src.width_ + src_x_from) * src.channels_;
     int dst_p = ((dst_y_from + y) * dst.width_ + dst_x_from) * dst.channels_;
     std::memcpy(dst.data_ + dst_p, src.data_ + src_p, x_width * src.channels_);
@@ -298,14 +284,14 @@ void write_to(Image const& src, Image& dst, int x, int y) {
 }
 
 // convert an image to grayscale
-Image grayscale(Image const& src) {
+Image grayscale(Image const& src, bool batched) {
   // non-RGB images are not supported
   assert(src.channels_ >= 3);
 
   auto start = std::chrono::steady_clock::now();
 
   Image dst = src;
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
+  for_each_row(batched, dst.height_, [&](int y) {
     for (int x = 0; x < dst.width_; ++x) {
       int p = (y * dst.width_ + x) * dst.channels_;
       int r = dst.data_[p];
@@ -329,7 +315,7 @@ Image grayscale(Image const& src) {
 }
 
 // apply an RGB tint to an image
-Image tint(Image const& src, int r, int g, int b) {
+Image tint(Image const& src, int r, int g, int b, bool batched) {
   // non-RGB images are not supported
   assert(src.channels_ >= 3);
 
@@ -337,7 +323,7 @@ Image tint(Image const& src, int r, int g, int b) {
 
   Image dst = src;
 
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
+  for_each_row(batched, dst.height_, [&](int y) {
     for (int x = 0; x < dst.width_; ++x) {
       int p = (y * dst.width_ + x) * dst.channels_;
       int r0 = dst.data_[p];
@@ -378,25 +364,57 @@ int main(int argc, const char* argv[]) {
   std::vector<Image> images;
   images.resize(files.size());
   for (unsigned int i = 0; i < files.size(); ++i) {
-    auto& img = images[i];
-    img.open(files[i]);
-    img.show();
-
-    Image small = scale(img, img.width_ * 0.5, img.height_ * 0.5);
-    Image gray = grayscale(small);
-    Image tone1 = tint(gray, 168, 56, 172);  // purple-ish
-    Image tone2 = tint(gray, 100, 143, 47);  // green-ish
-    Image tone3 = tint(gray, 255, 162, 36);  // gold-ish
-
-    Image out(img.width_, img.height_, img.channels_);
-    write_to(tone1, out, 0, 0);
-    write_to(tone2, out, img.width_ * 0.5, 0);
-    write_to(tone3, out, 0, img.height_ * 0.5);
-    write_to(gray, out, img.width_ * 0.5, img.height_ * 0.5);
+    images[i].open(files[i]);
+  }
+
+  // group the small images in batches, and put each large image in a batch of its own
+  std::vector<std::vector<unsigned int>> batches;
+  int pixels = batch_pixels;
+  for (unsigned int i = 0; i < images.size(); ++i) {
+    if (not is_small(images[i])) {
+      batches.push_back({i});
+      // start a new batch for the next small image, instead of adding it to this one
+      pixels = batch_pixels;
+      continue;
+    }
+    if (pixels >= batch_pixels) {
+      batches.emplace_back();
+      pixels = 0;
+    }
+    batches.back().push_back(i);
+    pixels += images[i].width_ * images[i].height_;
+  }
+
+  // process the batches in parallel: the kernels run sequentially for the small images, and in parallel for the
+  // large ones
+  std::vector<Image> results;
+  results.resize(files.size());
+  tbb::parallel_for<unsigned int>(0, batches.size(), 1, [&](unsigned int b) {
+    for (unsigned int i : batches[b]) {
+      auto& img = images[i];
+      // all the kernels follow the batching of the input image, even if the intermediate images are smaller
+      bool batched = is_small(img);
+      Image small = scale(img, img.width_ * 0.5, img.height_ * 0.5, batched);
+      Image gray = grayscale(small, batched);
+      Image tone1 = tint(gray, 168, 56, 172, batched);  // purple-ish
+      Image tone2 = tint(gray, 100, 143, 47, batched);  // green-ish
+      Image tone3 = tint(gray, 255, 162, 36, batched);  // gold-ish
+
+      Image out(img.width_, img.height_, img.channels_);
+      write_to(tone1, out, 0, 0, batched);
+      write_to(tone2, out, img.width_ * 0.5, 0, batched);
+      write_to(tone3, out, 0, img.height_ * 0.5, batched);
+      write_to(gray, out, img.width_ * 0.5, img.height_ * 0.5, batched);
+      results[i] = std::move(out);
+    }
+  });
 
+  // show and write the images in order
+  for (unsigned int i = 0; i < files.size(); ++i) {
+    images[i].show();
     std::cout << '\n';
-    out.show();
-    out.write(std::format("out{:02d}.jpg", i));
+    results[i].show();
+    results[i].write(std::format("out{:02d}.jpg", i));
   }
 
   return 0;
@@ -16,6 +16,10 @@ You should have received a copy of the GNU General Public License along
 with this program. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cstdint>
@@ -23,12 +27,22 @@ with this program. If not, see <https://www.gnu.org/licenses/>.
 #include <cstring>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <syncstream>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include <sys/resource.h>
+
 #include <tbb/tbb.h>
 
+#include "buffer_pool.h"
+#include "memo.h"
+#include "resample.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -44,23 +58,29 @@ struct Image {
   int width_ = 0;
   int height_ = 0;
   int channels_ = 0;
+  // the image data comes from the BufferPool, rather than from stb_image
+  bool pooled_ = false;
+  // content address of the image, or 0 if unknown
+  uint64_t hash_ = 0;
 
   Image() {}
 
   Image(std::string const& filename) { open(filename); }
 
   Image(int width, int height, int channels) : width_(width), height_(height), channels_(channels) {
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
     std::memset(data_, 0x00, size);
   }
 
   ~Image() { close(); }
 
   // copy constructor
-  Image(Image const& img) : width_(img.width_), height_(img.height_), channels_(img.channels_) {
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
+  Image(Image const& img) : width_(img.width_), height_(img.height_), channels_(img.channels_), hash_(img.hash_) {
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
     std::memcpy(data_, img.data_, size);
   }
 
@@ -77,15 +97,23 @@ struct Image {
     width_ = img.width_;
     height_ = img.height_;
     channels_ = img.channels_;
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    hash_ = img.hash_;
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
     std::memcpy(data_, img.data_, size);
 
     return *this;
   }
 
   // move constructor
-  Image(Image&& img) : data_(img.data_), width_(img.width_), height_(img.height_), channels_(img.channels_) {
+  Image(Image&& img)
+      : data_(img.data_),
+        width_(img.width_),
+        height_(img.height_),
+        channels_(img.channels_),
+        pooled_(img.pooled_),
+        hash_(img.hash_) {
     // take owndership of the image data
     img.data_ = nullptr;
   }
@@ -104,6 +132,8 @@ struct Image {
     width_ = img.width_;
     height_ = img.height_;
     channels_ = img.channels_;
+    pooled_ = img.pooled_;
+    hash_ = img.hash_;
 
     // take owndership of the image data
     data_ = img.data_;
@@ -141,9 +171,15 @@ struct Image {
 
   void close() {
     if (data_ != nullptr) {
-      stbi_image_free(data_);
+      if (pooled_) {
+        // return the buffer to the pool, for the next image of a similar size
+        BufferPool::instance().release(data_, static_cast<size_t>(width_) * height_ * channels_);
+      } else {
+        stbi_image_free(data_);
+      }
     }
     data_ = nullptr;
+    pooled_ = false;
   }
 
   static int sixel_write(char* data, int size, void* priv) {
@@ -179,66 +215,16 @@ struct Image {
 
 bool verbose = true;
 
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
+// make a scaled copy of an image, using the separable resampling engine
+Image scale(Image const& src, int width, int height, Filter filter = Filter::Bilinear) {
   if (width == src.width_ and height == src.height_) {
     // if the dimensions are the same, return a copy of the image
     return src;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
   auto start = std::chrono::steady_clock::now();
 
-  for (int y = 0; y < height; ++y) {
-    // map the row of the scaled image to the nearest rows of the original image
-    float yp = static_cast<float>(y) * src.height_ / height;
-    int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
-    int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
-
-    // interpolate between y0 and y1
-    float wy0 = yp - y0;
-    float wy1 = y1 - yp;
-    // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-    if (y0 == y1) {
-      wy0 = 1.f;
-      wy1 = 1.f;
-    }
-    float dy = wy0 + wy1;
-
-    for (int x = 0; x < width; ++x) {
-      int p = (y * out.width_ + x) * out.channels_;
-
-      // map the column of the scaled image to the nearest columns of the original image
-      float xp = static_cast<float>(x) * src.width_ / width;
-      int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
-      int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
-
-      // interpolate between x0 and x1
-      float wx0 = xp - x0;
-      float wx1 = x1 - xp;
-      // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-      if (x0 == x1) {
-        wx0 = 1.f;
-        wx1 = 1.f;
-      }
-      float dx = wx0 + wx1;
-
-      // bi-linear interpolation of all channels
-      int p00 = (y0 * src.width_ + x0) * src.channels_;
-      int p10 = (y1 * src.width_ + x0) * src.channels_;
-      int p01 = (y0 * src.width_ + x1) * src.channels_;
-      int p11 = (y1 * src.width_ + x1) * src.channels_;
-
-      for (int c = 0; c < src.channels_; ++c) {
-        out.data_[p + c] =
-            static_cast<unsigned char>(std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                                                   src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
-                                                  (dx * dy)));
-      }
-    }
-  }
+  Image out = Resampler::get(src.width_, src.height_, width, height, filter)->apply(src);
 
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
@@ -292,25 +278,24 @@ void write_to(Image const& src, Image& dst, int x, int y) {
   }
 }
 
-// convert an image to grayscale
-Image grayscale(Image const& src) {
+// convert an image to grayscale, in place
+void grayscale_inplace(Image& img) {
   // non-RGB images are not supported
-  assert(src.channels_ >= 3);
+  assert(img.channels_ >= 3);
 
   auto start = std::chrono::steady_clock::now();
 
-  Image dst = src;
-  for (int y = 0; y < dst.height_; ++y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r = dst.data_[p];
-      int g = dst.data_[p + 1];
-      int b = dst.data_[p + 2];
+  for (int y = 0; y < img.height_; ++y) {
+    for (int x = 0; x < img.width_; ++x) {
+      int p = (y * img.width_ + x) * img.channels_;
+      int r = img.data_[p];
+      int g = img.data_[p + 1];
+      int b = img.data_[p + 2];
       // NTSC values for RGB to grayscale conversion
       int y = (299 * r + 587 * g + 114 * b) / 1000;
-      dst.data_[p] = y;
-      dst.data_[p + 1] = y;
-      dst.data_[p + 2] = y;
+      img.data_[p] = y;
+      img.data_[p + 1] = y;
+      img.data_[p + 2] = y;
     }
   }
 
@@ -319,27 +304,37 @@ Image grayscale(Image const& src) {
   if (verbose) {
     std::cerr << std::format("grayscale:  {:6.2f}", ms) << " ms\n";
   }
+}
 
+// make a grayscale copy of an image
+Image grayscale(Image const& src) {
+  Image dst = src;
+  grayscale_inplace(dst);
   return dst;
 }
 
-// apply an RGB tint to an image
-Image tint(Image const& src, int r, int g, int b) {
+// convert an image to grayscale, reusing its buffer
+Image grayscale(Image&& src) {
+  grayscale_inplace(src);
+  return std::move(src);
+}
+
+// apply an RGB tint to an image, in place
+void tint_inplace(Image& img, int r, int g, int b) {
   // non-RGB images are not supported
-  assert(src.channels_ >= 3);
+  assert(img.channels_ >= 3);
 
   auto start = std::chrono::steady_clock::now();
 
-  Image dst = src;
-  for (int y = 0; y < dst.height_; ++y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r0 = dst.data_[p];
-      int g0 = dst.data_[p + 1];
-      int b0 = dst.data_[p + 2];
-      dst.data_[p] = r0 * r / 255;
-      dst.data_[p + 1] = g0 * g / 255;
-      dst.data_[p + 2] = b0 * b / 255;
+  for (int y = 0; y < img.height_; ++y) {
+    for (int x = 0; x < img.width_; ++x) {
+      int p = (y * img.width_ + x) * img.channels_;
+      int r0 = img.data_[p];
+      int g0 = img.data_[p + 1];
+      int b0 = img.data_[p + 2];
+      img.data_[p] = r0 * r / 255;
+      img.data_[p + 1] = g0 * g / 255;
+      img.data_[p + 2] = b0 * b / 255;
     }
   }
 
@@ -348,10 +343,73 @@ Image tint(Image const& src, int r, int g, int b) {
   if (verbose) {
     std::cerr << std::format("tint:       {:6.2f}", ms) << " ms\n";
   }
+}
 
+// make a tinted copy of an image
+Image tint(Image const& src, int r, int g, int b) {
+  Image dst = src;
+  tint_inplace(dst, r, g, b);
   return dst;
 }
 
+// apply an RGB tint to an image, reusing its buffer
+Image tint(Image&& src, int r, int g, int b) {
+  tint_inplace(src, r, g, b);
+  return std::move(src);
+}
+
+// apply an in-place operation to the image if the caller holds the only reference to it, or to a copy otherwise
+template <typename Operation>
+std::shared_ptr<Image> modify(std::shared_ptr<Image> const& img, Operation&& operation) {
+  if (img.use_count() == 1) {
+    operation(*img);
+    img->hash_ = 0;
+    return img;
+  }
+  auto copy = std::make_shared<Image>(*img);
+  operation(*copy);
+  copy->hash_ = 0;
+  return copy;
+}
+
+// an image in the flow graph, tagged with the position of the input image it derives from, used to match the images
+// in the flow graph; the id travels with the message rather than with the image, as the memoized stages can share the
+// same image between several inputs
+struct ImageMsg {
+  int id;
+  std::shared_ptr<Image> image;
+};
+
+// the input image processed by a flow graph node
+inline int input_id(ImageMsg const& msg) { return msg.id; }
+
+template <typename... Msgs>
+int input_id(std::tuple<ImageMsg, Msgs...> const& msgs) {
+  return std::get<0>(msgs).id;
+}
+
+// the images carried by one or more messages
+inline std::shared_ptr<Image> const& images(ImageMsg const& msg) { return msg.image; }
+
+template <typename... Msgs>
+auto images(std::tuple<Msgs...> const& msgs) {
+  return std::apply([](auto const&... msg) { return std::make_tuple(msg.image...); }, msgs);
+}
+
+// wrap the body of a flow graph node, to tag the resulting image with the input one; the nodes without a result
+// return the id of the input image
+template <typename Body>
+auto tagged(Body body) {
+  return [body](auto const& input) {
+    if constexpr (std::is_void_v<decltype(body(images(input)))>) {
+      body(images(input));
+      return input_id(input);
+    } else {
+      return ImageMsg{input_id(input), body(images(input))};
+    }
+  };
+}
+
 int main(int argc, const char* argv[]) {
   const char* verbose_env = std::getenv("VERBOSE");
   if (verbose_env != nullptr and std::strlen(verbose_env) != 0) {
@@ -369,59 +427,108 @@ int main(int argc, const char* argv[]) {
     }
   }
 
+  // limit the number of images being processed at the same time, to run large batches in a fixed memory budget: by
+  // default twice the number of threads, or the value of IN_FLIGHT
+  int in_flight = 2 * tbb::info::default_concurrency();
+  const char* in_flight_env = std::getenv("IN_FLIGHT");
+  if (in_flight_env != nullptr and std::strlen(in_flight_env) != 0) {
+    in_flight = std::max(std::atoi(in_flight_env), 1);
+  }
+
+  // memoize the results of the stages by content address with MEMO=<MB>
+  std::unique_ptr<StageCache<Image>> memo;
+  const char* memo_env = std::getenv("MEMO");
+  if (memo_env != nullptr and std::strlen(memo_env) != 0) {
+    double memo_size = std::atof(memo_env);
+    if (memo_size <= 0.) {
+      std::cerr << "Invalid memoization cache size " << memo_env << ", use a positive number of MB\n";
+      return 1;
+    }
+    memo = std::make_unique<StageCache<Image>>(static_cast<size_t>(memo_size * 1024 * 1024), nullptr);
+  }
+
   // count how many images have been processed
   std::atomic<int> counter = 0;
 
+  // count how many images have been read, to give each one an id
+  std::atomic<int> next_id = 0;
+
   // create a TBB flow graph
   tbb::flow::graph graph;
 
   // create the graph nodes
   using ImagePtr = std::shared_ptr<Image>;
   using ImageCmb = std::tuple<ImagePtr, ImagePtr, ImagePtr, ImagePtr>;
+  using MsgCmb = std::tuple<ImageMsg, ImageMsg, ImageMsg, ImageMsg>;
+
+  tbb::flow::queue_node<std::string> node_files(graph);  // queue the files waiting to be processed
 
-  tbb::flow::function_node<std::string, ImagePtr> node_open(  // read the image from a file
+  tbb::flow::limiter_node<std::string> node_limit(graph, in_flight);  // let a limited number of images in at a time
+
+  tbb::flow::function_node<std::string, ImageMsg> node_open(  // read the image from a file
+      graph,
+      tbb::flow::unlimited,
+      [&next_id, &memo](std::string filename) -> ImageMsg {
+        auto img = std::make_shared<Image>(filename);
+        if (memo) {
+          img->hash_ = content_hash(*img);
+        }
+        return {next_id++, img};
+      });
+
+  tbb::flow::function_node<ImageMsg, int> node_show_input(  // render the input on the terminal
       graph,
       tbb::flow::unlimited,
-      [](std::string filename) -> ImagePtr { return std::make_shared<Image>(filename); });
+      tagged([](ImagePtr img) { img->show(); }));
 
-  tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_show(  // render the image on the terminal
+  tbb::flow::function_node<ImageMsg, int> node_show(  // render the image on the terminal
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) { img->show(); });
+      tagged([](ImagePtr img) { img->show(); }));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_scale(  // scale down the image to 0.5x0.5
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_scale(  // scale down the image to 0.5x0.5
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr {
+      tagged(memoized(memo.get(), "scale", {1, 2, static_cast<int>(Filter::Bilinear)}, [](ImagePtr img) -> ImagePtr {
         return std::make_shared<Image>(scale(*img, img->width_ * 0.5, img->height_ * 0.5));
-      });
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_gray(  // generate a grayscale image
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_gray(  // generate a grayscale image
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(grayscale(*img)); });
+      tagged(memoized(memo.get(), "grayscale", {}, [](ImagePtr const& img) -> ImagePtr {
+        return modify(img, [](Image& img) { grayscale_inplace(img); });
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint1(  // apply a purple-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint1(  // apply a purple-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 168, 56, 172)); });
+      tagged(memoized(memo.get(), "tint", {168, 56, 172}, [](ImagePtr const& img) -> ImagePtr {
+        return modify(img, [](Image& img) { tint_inplace(img, 168, 56, 172); });
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint2(  // apply a green-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint2(  // apply a green-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 100, 143, 47)); });
+      tagged(memoized(memo.get(), "tint", {100, 143, 47}, [](ImagePtr const& img) -> ImagePtr {
+        return modify(img, [](Image& img) { tint_inplace(img, 100, 143, 47); });
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint3(  // apply a gold-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint3(  // apply a gold-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 255, 162, 36)); });
+      tagged(memoized(memo.get(), "tint", {255, 162, 36}, [](ImagePtr const& img) -> ImagePtr {
+        return modify(img, [](Image& img) { tint_inplace(img, 255, 162, 36); });
+      })));
 
-  tbb::flow::join_node<ImageCmb, tbb::flow::queueing> node_join(graph);
+  // the images from the same input are matched by their id, as several inputs can be in flight at the same time
+  auto image_id = [](ImageMsg const& msg) { return msg.id; };
+  tbb::flow::join_node<MsgCmb, tbb::flow::key_matching<int>> node_join(graph, image_id, image_id, image_id, image_id);
 
-  tbb::flow::function_node<ImageCmb, ImagePtr> node_result(  // combine the images
+  tbb::flow::function_node<MsgCmb, ImageMsg> node_result(  // combine the images
       graph,
       tbb::flow::unlimited,
-      [](ImageCmb images) -> ImagePtr {
+      tagged(memoized(memo.get(), "combine", {}, [](ImageCmb images) -> ImagePtr {
         int width = std::get<0>(images)->width_;
         int height = std::get<0>(images)->height_;
         int channels = std::get<0>(images)->channels_;
@@ -431,18 +538,37 @@ int main(int argc, const char* argv[]) {
         write_to(*std::get<2>(images), out, 0, height);
         write_to(*std::get<3>(images), out, width, height);
         return std::make_shared<Image>(std::move(out));
-      });
+      })));
 
-  tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_write(  // write the image to a file
+  tbb::flow::function_node<ImageMsg, int> node_write(  // write the image to a file
       graph,
       tbb::flow::unlimited,
-      [&counter](ImagePtr img) {
+      tagged([&counter](ImagePtr img) {
         std::string filename = std::format("out{:02d}.jpg", counter++);
         img->write(filename);
-      });
+      }));
 
-  // create the graph edges
-  tbb::flow::make_edge(node_open, node_show);
+  // each node reports the id of the image it has completed, so that the limiter is decremented only once all three
+  // nodes are done with the same image
+  using DoneCmb = std::tuple<int, int, int>;
+  auto done_id = [](int id) { return id; };
+  tbb::flow::join_node<DoneCmb, tbb::flow::key_matching<int>> node_join_done(graph, done_id, done_id, done_id);
+
+  tbb::flow::function_node<DoneCmb, tbb::flow::continue_msg> node_done(  // an image has been shown and written
+      graph,
+      tbb::flow::serial,
+      [](DoneCmb) { return tbb::flow::continue_msg(); });
+
+  // create the graph edges; once an image has been shown and written the limiter lets the next one through, so
+  // none of its buffers can be held by a pending node
+  tbb::flow::make_edge(node_files, node_limit);
+  tbb::flow::make_edge(node_limit, node_open);
+  tbb::flow::make_edge(node_open, node_show_input);
+  tbb::flow::make_edge(node_show_input, tbb::flow::input_port<0>(node_join_done));
+  tbb::flow::make_edge(node_show, tbb::flow::input_port<1>(node_join_done));
+  tbb::flow::make_edge(node_write, tbb::flow::input_port<2>(node_join_done));
+  tbb::flow::make_edge(node_join_done, node_done);
+  tbb::flow::make_edge(node_done, node_limit.decrementer());
   tbb::flow::make_edge(node_open, node_scale);
   tbb::flow::make_edge(node_scale, node_gray);
   tbb::flow::make_edge(node_gray, node_tint1);
@@ -458,11 +584,34 @@ int main(int argc, const char* argv[]) {
 
   // send data through the graph
   for (auto const& filename : files) {
-    node_open.try_put(filename);
+    node_files.try_put(filename);
   }
 
   // wait for all operation to complete
   graph.wait_for_all();
 
+  if (verbose) {
+    auto stats = BufferPool::instance().stats();
+    std::cerr << std::format("buffer pool: {} hits, {} misses, {:.2f} MB peak resident, {:.2f} MB cached",
+                             stats.hits,
+                             stats.misses,
+                             stats.peak / 1.e6,
+                             stats.cached / 1.e6)
+              << '\n';
+
+    if (memo) {
+      auto stats = memo->stats();
+      std::cerr << std::format("stage cache: {} hits, {} misses", stats.hits, stats.misses) << '\n';
+    }
+
+    // high-water mark of the memory used by the whole process
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cerr << std::format("memory: {:.2f} MB peak resident set size, with up to {} images in flight",
+                             usage.ru_maxrss / 1.e3,
+                             in_flight)
+              << '\n';
+  }
+
   return 0;
 }
@@ -0,0 +1,575 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef benchmark_h
+#define benchmark_h
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <tbb/tbb.h>
+
+#include "composite.h"
+#include "encode.h"
+#include "image.h"
+#include "kernels.h"
+#include "mosaic.h"
+#include "simd.h"
+#include "tiled_image.h"
+
+// make a scaled copy of an image, with a per-pixel bi-linear interpolation;
+// used as a reference for the resampling engine
+inline Image scale_reference(Image const& src, int width, int height) {
+  if (width == src.width_ and height == src.height_) {
+    // if the dimensions are the same, return a copy of the image
+    return src;
+  }
+
+  // create a new image
+  Image out(width, height, src.channels_);
+
+  auto start = std::chrono::steady_clock::now();
+
+  tbb::parallel_for(
+      tbb::blocked_range2d<int, int>{0, height, 16, 0, width, 16},
+      [&](tbb::blocked_range2d<int, int> const& range) {
+        for (int y = range.rows().begin(); y < range.rows().end(); ++y) {
+          // map the row of the scaled image to the nearest rows of the original image
+          float yp = static_cast<float>(y) * src.height_ / height;
+          int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
+          int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
+
+          // interpolate between y0 and y1
+          float wy0 = yp - y0;
+          float wy1 = y1 - yp;
+          // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
+          if (y0 == y1) {
+            wy0 = 1.f;
+            wy1 = 1.f;
+          }
+          float dy = wy0 + wy1;
+
+          for (int x = range.cols().begin(); x < range.cols().end(); ++x) {
+            int p = (y * out.width_ + x) * out.channels_;
+
+            // map the column of the scaled image to the nearest columns of the original image
+            float xp = static_cast<float>(x) * src.width_ / width;
+            int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
+            int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
+
+            // interpolate between x0 and x1
+            float wx0 = xp - x0;
+            float wx1 = x1 - xp;
+            // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
+            if (x0 == x1) {
+              wx0 = 1.f;
+              wx1 = 1.f;
+            }
+            float dx = wx0 + wx1;
+
+            // bi-linear interpolation of all channels
+            int p00 = (y0 * src.width_ + x0) * src.channels_;
+            int p10 = (y1 * src.width_ + x0) * src.channels_;
+            int p01 = (y0 * src.width_ + x1) * src.channels_;
+            int p11 = (y1 * src.width_ + x1) * src.channels_;
+
+            for (int c = 0; c < src.channels_; ++c) {
+              out.data_[p + c] = static_cast<unsigned char>(
+                  std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
+                              src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
+                             (dx * dy)));
+            }
+          }
+        }
+      },
+      tbb::simple_partitioner());
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("scale:      {:6.2f}", ms) << " ms\n";
+  }
+
+  return out;
+}
+
+// best time per call of a kernel, in ms, after a first warm-up call
+template <typename Kernel>
+float best_time_ms(int repetitions, Kernel&& kernel) {
+  kernel();
+  float best = std::numeric_limits<float>::max();
+  for (int i = 0; i < repetitions; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f);
+  }
+  return best;
+}
+
+// measure the reference bi-linear kernel and the separable resampling engine on the same image
+inline void benchmark_scale(Image const& img, int repetitions) {
+  // silence the per-kernel timing
+  bool was_verbose = verbose;
+  verbose = false;
+
+  int width = img.width_ * 0.5;
+  int height = img.height_ * 0.5;
+
+  std::cout << std::format("scaling {} x {} to {} x {}, {} channels, {} repetitions\n",
+                           img.width_,
+                           img.height_,
+                           width,
+                           height,
+                           img.channels_,
+                           repetitions);
+
+  float reference = best_time_ms(repetitions, [&] { scale_reference(img, width, height); });
+  std::cout << std::format("  {:<20} {:8.3f} ms\n", "reference bilinear", reference);
+
+  const std::pair<const char*, Filter> filters[] = {
+      {"bilinear", Filter::Bilinear}, {"box", Filter::Box}, {"lanczos3", Filter::Lanczos3}};
+  for (auto [name, filter] : filters) {
+    float ms = best_time_ms(repetitions, [&] { scale(img, width, height, filter); });
+    std::cout << std::format("  {:<20} {:8.3f} ms  ({:.2f}x)\n", name, ms, reference / ms);
+  }
+
+  // check how much the fixed-point bi-linear interpolation deviates from the reference one
+  Image expected = scale_reference(img, width, height);
+  Image actual = scale(img, width, height, Filter::Bilinear);
+  int max_diff = 0;
+  for (int i = 0; i < width * height * img.channels_; ++i) {
+    max_diff = std::max(max_diff, std::abs(expected.data_[i] - actual.data_[i]));
+  }
+  std::cout << std::format("  maximum difference between the bilinear kernels: {}\n", max_diff);
+
+  verbose = was_verbose;
+}
+
+// measure the grayscale and tint kernels for each instruction set supported by the CPU, and check that their results
+// are identical to the scalar ones
+inline void benchmark_simd(Image const& img, int repetitions) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  std::cout << std::format("converting {} x {} pixels, {} channels, {} repetitions\n",
+                           img.width_,
+                           img.height_,
+                           img.channels_,
+                           repetitions);
+
+  // run a kernel over all the rows of a copy of the image, on a single thread
+  auto run = [&img](auto&& kernel, auto&& tail) -> Image {
+    Image dst = img;
+    for (int y = 0; y < dst.height_; ++y) {
+      unsigned char* row = dst.data_ + y * dst.width_ * dst.channels_;
+      int done = kernel(row, dst.width_, dst.channels_);
+      tail(row + done * dst.channels_, dst.width_ - done, dst.channels_);
+    }
+    return dst;
+  };
+
+  auto supported = supported_simd_kernels();
+  Image gray_reference;
+  Image tint_reference;
+  float gray_baseline = 0.f;
+  float tint_baseline = 0.f;
+  for (auto const& kernels : supported) {
+    auto gray = [&] {
+      return run(kernels.grayscale, [](unsigned char* data, int pixels, int channels) {
+        return grayscale_scalar(data, pixels, channels);
+      });
+    };
+    auto tinted = [&] {
+      return run(
+          [&](unsigned char* data, int pixels, int channels) {
+            return kernels.tint(data, pixels, channels, 255, 162, 36);
+          },
+          [](unsigned char* data, int pixels, int channels) {
+            return tint_scalar(data, pixels, channels, 255, 162, 36);
+          });
+    };
+    float gray_ms = best_time_ms(repetitions, gray);
+    float tint_ms = best_time_ms(repetitions, tinted);
+    Image gray_result = gray();
+    Image tint_result = tinted();
+
+    bool exact = true;
+    if (gray_reference.data_ == nullptr) {
+      gray_reference = std::move(gray_result);
+      tint_reference = std::move(tint_result);
+      gray_baseline = gray_ms;
+      tint_baseline = tint_ms;
+    } else {
+      size_t size = img.width_ * img.height_ * img.channels_;
+      exact = std::memcmp(gray_result.data_, gray_reference.data_, size) == 0 and
+              std::memcmp(tint_result.data_, tint_reference.data_, size) == 0;
+    }
+    std::cout << std::format("  {:<8} grayscale {:8.3f} ms ({:.2f}x), tint {:8.3f} ms ({:.2f}x), {}\n",
+                             kernels.name,
+                             gray_ms,
+                             gray_baseline / gray_ms,
+                             tint_ms,
+                             tint_baseline / tint_ms,
+                             exact ? "bit-exact" : "MISMATCH");
+  }
+
+  // the single-channel grayscale conversion writes one byte per pixel, into a new image; run it on a single thread,
+  // like the kernels above, and silence its timing
+  bool was_verbose = verbose;
+  verbose = false;
+  tbb::task_arena arena(1);
+  float single_ms = best_time_ms(repetitions, [&] { arena.execute([&] { luminance(img); }); });
+  Image single = luminance(img);
+  verbose = was_verbose;
+
+  bool exact = true;
+  for (int i = 0; i < img.width_ * img.height_; ++i) {
+    exact = exact and single.data_[i] == gray_reference.data_[i * img.channels_];
+  }
+  std::cout << std::format("  {:<8} grayscale {:8.3f} ms ({:.2f}x), single-channel output, {}\n",
+                           "1-chan",
+                           single_ms,
+                           gray_baseline / single_ms,
+                           exact ? "bit-exact" : "MISMATCH");
+}
+
+// compare the staged pipeline, that materialises each intermediate image, with the fused mosaic operator
+inline void benchmark_mosaic(Image const& img, int repetitions) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  // silence the per-kernel timing
+  bool was_verbose = verbose;
+  verbose = false;
+
+  int width = img.width_ * 0.5;
+  int height = img.height_ * 0.5;
+
+  auto staged = [&] {
+    Image small = scale(img, width, height, Filter::Box);
+    Image gray = grayscale(std::move(small));
+    Image tone1 = tint(gray, tints[0].r, tints[0].g, tints[0].b);
+    Image tone2 = tint(gray, tints[1].r, tints[1].g, tints[1].b);
+    Image tone3 = tint(gray, tints[2].r, tints[2].g, tints[2].b);
+    Image out(width * 2, height * 2, img.channels_);
+    composite(out, {{&tone1, 0, 0}, {&tone2, width, 0}, {&tone3, 0, height}, {&gray, width, height}});
+    return out;
+  };
+  auto fused = [&] { return mosaic(img, width, height, Filter::Box, tints); };
+
+  // estimate of the bytes read from and written to whole-image buffers, computed from the image sizes rather than
+  // measured, including the initialisation of the new images; the row buffers used by the resampler and by the fused
+  // operator stay in cache and are not counted
+  size_t input = static_cast<size_t>(img.width_) * img.height_ * img.channels_;
+  size_t vertical = static_cast<size_t>(img.width_) * height * img.channels_;
+  size_t small = static_cast<size_t>(width) * height * img.channels_;
+  size_t staged_bytes = (input + 3 * vertical + 2 * small)  // scale: vertical and horizontal passes
+                        + 2 * small                         // grayscale: update in place
+                        + 3 * 4 * small                     // tints: copy, then update in place
+                        + 4 * small + 4 * 2 * small;        // mosaic: initialisation and four copies
+  size_t fused_bytes = input + 2 * 4 * small;               // read the input, initialise and write the mosaic
+
+  float staged_ms = best_time_ms(repetitions, staged);
+  float fused_ms = best_time_ms(repetitions, fused);
+  Image expected = staged();
+  Image actual = fused();
+  bool identical = std::memcmp(expected.data_, actual.data_, 4 * small) == 0;
+
+  std::cout << std::format("mosaic of {} x {} pixels, {} channels, {} repetitions\n",
+                           img.width_,
+                           img.height_,
+                           img.channels_,
+                           repetitions);
+  std::cout << std::format("  {:<8} {:8.3f} ms, {:8.2f} MB moved per image (estimated), {:6.2f} GB/s\n",
+                           "staged",
+                           staged_ms,
+                           staged_bytes / 1.e6,
+                           staged_bytes / staged_ms / 1.e6);
+  std::cout << std::format("  {:<8} {:8.3f} ms, {:8.2f} MB moved per image (estimated), {:6.2f} GB/s ({:.2f}x), {}\n",
+                           "fused",
+                           fused_ms,
+                           fused_bytes / 1.e6,
+                           fused_bytes / fused_ms / 1.e6,
+                           staged_ms / fused_ms,
+                           identical ? "identical" : "MISMATCH");
+
+  verbose = was_verbose;
+}
+
+// compare four write_to() calls with a single composite() pass, assembling a 4K mosaic from four quadrants, and
+// measure the alpha blending of a half-transparent copy of the image over the mosaic
+inline void benchmark_composite(Image const& img, int repetitions) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  // silence the per-kernel timing
+  bool was_verbose = verbose;
+  verbose = false;
+
+  const int width = 1920;
+  const int height = 1080;
+  Image quadrant = scale(img, width, height, Filter::Bilinear);
+  Image gray = grayscale(quadrant);
+  Image tone1 = tint(quadrant, tints[0].r, tints[0].g, tints[0].b);
+  Image tone2 = tint(quadrant, tints[1].r, tints[1].g, tints[1].b);
+  std::vector<Placement> placements = {
+      {&tone1, 0, 0}, {&tone2, width, 0}, {&gray, 0, height}, {&quadrant, width, height}};
+
+  Image expected(width * 2, height * 2, img.channels_);
+  Image actual(width * 2, height * 2, img.channels_);
+  float separate_ms = best_time_ms(repetitions, [&] {
+    for (auto const& placement : placements) {
+      write_to(*placement.image, expected, placement.x, placement.y);
+    }
+  });
+  float batched_ms = best_time_ms(repetitions, [&] { composite(actual, placements); });
+  size_t size = static_cast<size_t>(width) * height * 4 * img.channels_;
+  bool identical = std::memcmp(expected.data_, actual.data_, size) == 0;
+
+  // blend a copy of the image, centred and 50% transparent, over the mosaic
+  Image overlay = scale(img, width, height, Filter::Bilinear);
+  std::vector<Placement> blended = placements;
+  blended.push_back({&overlay, width / 2, height / 2, 128});
+  float blend_ms = best_time_ms(repetitions, [&] { composite(actual, blended); });
+
+  std::cout << std::format("composite of 4 x {} x {} pixels, {} channels, {} repetitions\n",
+                           width,
+                           height,
+                           img.channels_,
+                           repetitions);
+  std::cout << std::format("  {:<8} {:8.3f} ms\n", "write_to", separate_ms);
+  std::cout << std::format("  {:<8} {:8.3f} ms ({:.2f}x), {}\n",
+                           "batched",
+                           batched_ms,
+                           separate_ms / batched_ms,
+                           identical ? "identical" : "MISMATCH");
+  std::cout << std::format("  {:<8} {:8.3f} ms, with an alpha-blended overlay\n", "blended", blend_ms);
+
+  verbose = was_verbose;
+}
+
+// run the same pipeline on a large tiled image of width x height pixels, and measure how much its working set grows,
+// then compare the tiled images with the interleaved ones on an 8K image; the tiled images are backed by scratch files
+// in the temporary directory, and the benchmark is skipped if they cannot be created
+inline void benchmark_tiled(Image const& img, int repetitions, int width, int height) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  // silence the per-kernel timing
+  bool was_verbose = verbose;
+  verbose = false;
+
+  // scale down, convert to grayscale, and combine a tinted and an untinted copy; the tiled images are not copied
+  auto pipeline = [](auto const& input) {
+    using ImageType = std::remove_cvref_t<decltype(input)>;
+    int width = input.width_ / 2;
+    int height = input.height_ / 2;
+    ImageType gray = scale(input, width, height, Filter::Box);
+    grayscale_inplace(gray);
+    ImageType out(width * 2, height * 2, input.channels_);
+    write_to(gray, out, width, height);
+    tint_inplace(gray, tints[0].r, tints[0].g, tints[0].b);
+    write_to(gray, out, 0, 0);
+    return out;
+  };
+
+  // peak resident memory, in MB
+  auto peak_rss = [] {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1.e3;
+  };
+
+  // the large pipeline is run only once; it needs twice the size of the image as scratch space
+  try {
+    double rss = peak_rss();
+    auto start = std::chrono::steady_clock::now();
+    TiledImage input = scale(TiledImage(img), width, height, Filter::Bilinear);
+    TiledImage output = pipeline(input);
+    auto finish = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+    std::cout << std::format("tiled pipeline on {} x {} pixels, {} channels, {:.2f} GB\n",
+                             width,
+                             height,
+                             img.channels_,
+                             input.size() / 1.e9);
+    std::cout << std::format("  {:<16} {:8.3f} ms, peak resident set size increased by {:.2f} MB\n",
+                             "tiled",
+                             ms,
+                             peak_rss() - rss);
+  } catch (std::runtime_error const& error) {
+    std::cerr << std::format("Skipping the tiled pipeline on {} x {} pixels: {}\n", width, height, error.what());
+    verbose = was_verbose;
+    return;
+  }
+
+  width = 7680;
+  height = 4320;
+  Image input = scale(img, width, height, Filter::Bilinear);
+  TiledImage tiled(input);
+
+  float interleaved_ms = best_time_ms(repetitions, [&] { pipeline(input); });
+  float tiled_ms = best_time_ms(repetitions, [&] { pipeline(tiled); });
+  float to_tiled_ms = best_time_ms(repetitions, [&] { TiledImage{input}; });
+  float to_interleaved_ms = best_time_ms(repetitions, [&] { tiled.interleaved(); });
+
+  Image expected = pipeline(input);
+  Image actual = pipeline(tiled).interleaved();
+  bool identical = std::memcmp(expected.data_, actual.data_, static_cast<size_t>(width) * height * img.channels_) == 0;
+
+  std::cout << std::format("8K pipeline on {} x {} pixels, {} channels, {} repetitions\n",
+                           width,
+                           height,
+                           img.channels_,
+                           repetitions);
+  std::cout << std::format("  {:<16} {:8.3f} ms\n", "interleaved", interleaved_ms);
+  std::cout << std::format("  {:<16} {:8.3f} ms  ({:.2f}x), {}\n",
+                           "tiled",
+                           tiled_ms,
+                           interleaved_ms / tiled_ms,
+                           identical ? "identical" : "MISMATCH");
+  std::cout << std::format("  {:<16} {:8.3f} ms\n", "to tiled", to_tiled_ms);
+  std::cout << std::format("  {:<16} {:8.3f} ms\n", "to interleaved", to_interleaved_ms);
+
+  verbose = was_verbose;
+}
+
+// compare the latency of loading and decoding small (~100 kB) and large (~50 MB) PNG files through stdio, with a
+// single read into a buffer, and from a memory mapping; the files are filled with noise, so they do not compress, and
+// are read from the page cache after the first repetition
+inline void benchmark_open(int repetitions) {
+  // silence the per-image messages
+  bool was_verbose = verbose;
+  verbose = false;
+
+  // member functions used to load an image
+  const std::pair<const char*, void (Image::*)(std::string const&)> loaders[] = {
+      {"stdio", &Image::open_stdio}, {"read", &Image::open}, {"mmap", &Image::open_mmap}};
+
+  const std::tuple<const char*, int> sizes[] = {{"small", 185}, {"large", 4096}};
+  for (auto [name, side] : sizes) {
+    // generate an RGB image filled with noise, and write it as a PNG file
+    Image noise(side, side, 3);
+    std::mt19937 engine(side);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for (size_t i = 0; i < static_cast<size_t>(side) * side * 3; ++i) {
+      noise.data_[i] = distribution(engine);
+    }
+    std::string filename = (std::filesystem::temp_directory_path() / std::format("benchmark_{}.png", name)).string();
+    noise.write(filename);
+    auto size = std::filesystem::file_size(filename);
+
+    std::cout << std::format(
+        "loading a {} x {} PNG file of {:.2f} MB, {} repetitions\n", side, side, size / 1.e6, repetitions);
+    float baseline = 0.f;
+    for (auto [loader_name, loader] : loaders) {
+      float ms = best_time_ms(repetitions, [&] {
+        Image img;
+        (img.*loader)(filename);
+      });
+      if (baseline == 0.f) {
+        baseline = ms;
+      }
+      std::cout << std::format("  {:<8} {:8.3f} ms, {:8.2f} MB/s ({:.2f}x)\n",
+                               loader_name,
+                               ms,
+                               size / ms / 1.e3,
+                               baseline / ms);
+    }
+    std::filesystem::remove(filename);
+  }
+
+  verbose = was_verbose;
+}
+
+// compare the single-threaded stb_image_write encoders with the parallel ones, on a 4K version of an image; the
+// files written by the parallel encoders are decoded again, and compared with the original image
+inline void benchmark_write(Image const& img, int repetitions) {
+  // silence the per-image messages
+  bool was_verbose = verbose;
+  verbose = false;
+
+  Image input = scale(img, 3840, 2160, Filter::Bilinear);
+  size_t size = static_cast<size_t>(input.width_) * input.height_ * input.channels_;
+
+  // peak signal-to-noise ratio of a decoded file with respect to the input image, in dB
+  auto psnr = [&](std::string const& filename) {
+    Image decoded;
+    decoded.open(filename);
+    int channels = std::min(decoded.channels_, input.channels_);
+    double error = 0.;
+    for (size_t p = 0; p < static_cast<size_t>(input.width_) * input.height_; ++p) {
+      for (int c = 0; c < channels; ++c) {
+        double diff = decoded.data_[p * decoded.channels_ + c] - input.data_[p * input.channels_ + c];
+        error += diff * diff;
+      }
+    }
+    error /= static_cast<double>(input.width_) * input.height_ * channels;
+    return error == 0. ? std::numeric_limits<double>::infinity() : 10. * std::log10(255. * 255. / error);
+  };
+
+  std::cout << std::format("encoding {} x {} pixels, {} channels, {} repetitions\n",
+                           input.width_,
+                           input.height_,
+                           input.channels_,
+                           repetitions);
+  for (auto format : {"png", "jpg"}) {
+    std::string stb_file = (std::filesystem::temp_directory_path() / std::format("benchmark_stb.{}", format)).string();
+    std::string tbb_file = (std::filesystem::temp_directory_path() / std::format("benchmark_tbb.{}", format)).string();
+    float stb_ms = best_time_ms(repetitions, [&] { input.write_stb(stb_file); });
+    float tbb_ms = best_time_ms(repetitions, [&] { input.write(tbb_file); });
+
+    for (auto [name, filename, ms] : {std::tuple{"stb", stb_file, stb_ms}, std::tuple{"parallel", tbb_file, tbb_ms}}) {
+      double quality = psnr(filename);
+      std::cout << std::format("  {} {:<8} {:8.3f} ms, {:8.2f} MB/s ({:.2f}x), {:8.2f} MB file, {}\n",
+                               format,
+                               name,
+                               ms,
+                               size / ms / 1.e3,
+                               stb_ms / ms,
+                               std::filesystem::file_size(filename) / 1.e6,
+                               std::isinf(quality) ? std::string("lossless") : std::format("PSNR {:.2f} dB", quality));
+      std::filesystem::remove(filename);
+    }
+  }
+
+  verbose = was_verbose;
+}
+
+#endif  // benchmark_h
@@ -0,0 +1,300 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef kernels_h
+#define kernels_h
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <utility>
+
+#include <tbb/tbb.h>
+
+#include "channels.h"
+#include "image.h"
+#include "mosaic.h"
+#include "resample.h"
+#include "simd.h"
+#include "trace.h"
+#include "tuner.h"
+
+// make a scaled copy of an image, using the separable resampling engine
+inline Image scale(Image const& src, int width, int height, Filter filter = Filter::Bilinear) {
+  TraceScope trace("scale");
+  if (width == src.width_ and height == src.height_) {
+    // if the dimensions are the same, return a copy of the image
+    return src;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  Image out = Resampler::get(src.width_, src.height_, width, height, filter)->apply(src, TunedRows{});
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("scale:      {:6.2f}", ms) << " ms\n";
+  }
+
+  return out;
+}
+
+// copy a source image into a target image, cropping any parts that fall outside the target image; a single-channel
+// source image can be copied into an RGB or RGBA target image, replicating its value in each colour channel
+inline void write_to(Image const& src, Image& dst, int x, int y) {
+  TraceScope trace("write_to");
+  // copying to an image with a different number of channels is not supported, apart from the grayscale case
+  assert(src.channels_ == dst.channels_ or src.channels_ == 1);
+
+  // the whole source image would fall outside of the target image along the X axis
+  if ((x + src.width_ < 0) or (x >= dst.width_)) {
+    return;
+  }
+
+  // the whole source image would fall outside of the target image along the Y axis
+  if ((y + src.height_ < 0) or (y >= dst.height_)) {
+    return;
+  }
+
+  // find the valid range for the overlapping part of the images along the X and Y axes
+  int src_x_from = std::max(0, -x);
+  int src_x_to = std::min(src.width_, dst.width_ - x);
+  int dst_x_from = std::max(0, x);
+  //int dst_x_to   = std::min(src.width_ + x, dst.width_);
+  int x_width = src_x_to - src_x_from;
+
+  int src_y_from = std::max(0, -y);
+  int src_y_to = std::min(src.height_, dst.height_ - y);
+  int dst_y_from = std::max(0, y);
+  //int dst_y_to   = std::min(src.height_ + y, dst.height_);
+  int y_height = src_y_to - src_y_from;
+
+  auto start = std::chrono::steady_clock::now();
+
+  if (src.channels_ == dst.channels_) {
+    tuned_for("write_to", y_height, x_width, [&](int y) {
+      size_t src_p = (static_cast<size_t>(src_y_from + y) * src.width_ + src_x_from) * src.channels_;
+      size_t dst_p = (static_cast<size_t>(dst_y_from + y) * dst.width_ + dst_x_from) * dst.channels_;
+      std::memcpy(dst.data_ + dst_p, src.data_ + src_p, x_width * src.channels_);
+    });
+  } else {
+    with_channels<3, 4>(dst.channels_, [&](auto channels) {
+      tuned_for("write_to_gray", y_height, x_width, [&](int y) {
+        const unsigned char* in = src.data_ + static_cast<size_t>(src_y_from + y) * src.width_ + src_x_from;
+        unsigned char* out = dst.data_ + (static_cast<size_t>(dst_y_from + y) * dst.width_ + dst_x_from) * channels;
+        for (int x = 0; x < x_width; ++x) {
+          out[x * channels] = in[x];
+          out[x * channels + 1] = in[x];
+          out[x * channels + 2] = in[x];
+          if constexpr (channels == 4) {
+            // opaque alpha channel
+            out[x * channels + 3] = 255;
+          }
+        }
+      });
+    });
+  }
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("write_to:   {:6.2f}", ms) << " ms\n";
+  }
+}
+
+// convert an image to grayscale, in place; the images without colour channels are already grayscale
+inline void grayscale_inplace(Image& img) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  TraceScope trace("grayscale");
+  auto start = std::chrono::steady_clock::now();
+
+  auto const& kernels = simd_kernels();
+  with_channels<3, 4>(img.channels_, [&](auto channels) {
+    tuned_for("grayscale", img.height_, img.width_, [&](int y) {
+      unsigned char* row = img.data_ + static_cast<size_t>(y) * img.width_ * channels;
+      int done = kernels.grayscale(row, img.width_, channels);
+      grayscale_scalar<channels>(row + done * channels, img.width_ - done);
+    });
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("grayscale:  {:6.2f}", ms) << " ms\n";
+  }
+}
+
+// make a grayscale copy of an image
+inline Image grayscale(Image const& src) {
+  Image dst = src;
+  grayscale_inplace(dst);
+  return dst;
+}
+
+// convert an image to grayscale, reusing its buffer
+inline Image grayscale(Image&& src) {
+  grayscale_inplace(src);
+  return std::move(src);
+}
+
+// make a single-channel grayscale copy of an image, instead of repeating the value in each channel; the gray value
+// of the images without colour channels is copied, and their alpha channel is dropped
+inline Image luminance(Image const& src) {
+  TraceScope trace("luminance");
+  auto start = std::chrono::steady_clock::now();
+
+  Image dst(src.width_, src.height_, 1);
+  with_channels<1, 2, 3, 4>(src.channels_, [&](auto channels) {
+    tuned_for("luminance", src.height_, src.width_, [&](int y) {
+      const unsigned char* in = src.data_ + static_cast<size_t>(y) * src.width_ * channels;
+      unsigned char* out = dst.data_ + static_cast<size_t>(y) * src.width_;
+      const int width = src.width_;
+      for (int x = 0; x < width; ++x) {
+        if constexpr (channels < 3) {
+          out[x] = in[x * channels];
+        } else {
+          // NTSC values for RGB to grayscale conversion, with the same exact division as the SIMD kernels
+          uint32_t sum = 299 * in[x * channels] + 587 * in[x * channels + 1] + 114 * in[x * channels + 2];
+          out[x] = ((sum >> 3) * 33555) >> 22;
+        }
+      }
+    });
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("luminance:  {:6.2f}", ms) << " ms\n";
+  }
+
+  return dst;
+}
+
+// apply an RGB tint to an image, in place; the images without colour channels cannot be tinted in place, and are left
+// unchanged: tint() colorizes them into new images
+inline void tint_inplace(Image& img, int r, int g, int b) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  TraceScope trace("tint");
+  auto start = std::chrono::steady_clock::now();
+
+  auto const& kernels = simd_kernels();
+  with_channels<3, 4>(img.channels_, [&](auto channels) {
+    tuned_for("tint", img.height_, img.width_, [&](int y) {
+      unsigned char* row = img.data_ + static_cast<size_t>(y) * img.width_ * channels;
+      int done = kernels.tint(row, img.width_, channels, r, g, b);
+      tint_scalar<channels>(row + done * channels, img.width_ - done, r, g, b);
+    });
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("tint:       {:6.2f}", ms) << " ms\n";
+  }
+}
+
+// make an RGB copy of a single-channel grayscale image, or an RGBA copy of a grayscale image with an alpha channel,
+// with the given tint
+inline Image colorize(Image const& src, int r, int g, int b) {
+  TraceScope trace("colorize");
+  // only the images without colour channels are supported
+  assert(src.channels_ <= 2);
+
+  auto start = std::chrono::steady_clock::now();
+
+  Image dst(src.width_, src.height_, src.channels_ + 2);
+  with_channels<1, 2>(src.channels_, [&](auto channels) {
+    tuned_for("colorize", src.height_, src.width_, [&](int y) {
+      const unsigned char* in = src.data_ + static_cast<size_t>(y) * src.width_ * channels;
+      unsigned char* out = dst.data_ + static_cast<size_t>(y) * src.width_ * (channels + 2);
+      const int width = src.width_;
+      for (int x = 0; x < width; ++x) {
+        // same exact division by 255 as the SIMD kernels
+        uint32_t value = in[x * channels];
+        out[x * (channels + 2)] = (value * r * 0x8081) >> 23;
+        out[x * (channels + 2) + 1] = (value * g * 0x8081) >> 23;
+        out[x * (channels + 2) + 2] = (value * b * 0x8081) >> 23;
+        if constexpr (channels == 2) {
+          out[x * (channels + 2) + 3] = in[x * channels + 1];
+        }
+      }
+    });
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("colorize:   {:6.2f}", ms) << " ms\n";
+  }
+
+  return dst;
+}
+
+// make a tinted copy of an image; the images without colour channels are tinted into RGB or RGBA images
+inline Image tint(Image const& src, int r, int g, int b) {
+  if (src.channels_ < 3) {
+    return colorize(src, r, g, b);
+  }
+  Image dst = src;
+  tint_inplace(dst, r, g, b);
+  return dst;
+}
+
+// apply an RGB tint to an image, reusing its buffer
+inline Image tint(Image&& src, int r, int g, int b) {
+  if (src.channels_ < 3) {
+    return colorize(src, r, g, b);
+  }
+  tint_inplace(src, r, g, b);
+  return std::move(src);
+}
+
+// fused "scale, grayscale, tint and mosaic" operator, with the rows split among the tasks by the tuner
+inline Image mosaic(Image const& src,
+                    int width,
+                    int height,
+                    Filter filter,
+                    std::array<Color, 3> const& colors,
+                    bool single_channel = false) {
+  TraceScope trace("mosaic");
+  auto start = std::chrono::steady_clock::now();
+
+  Image out = mosaic(src, width, height, filter, colors, single_channel, TunedRows{});
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("mosaic:     {:6.2f}", ms) << " ms\n";
+  }
+
+  return out;
+}
+
+#endif  // kernels_h
@@ -16,366 +16,255 @@ You should have received a copy of the GNU General Public License along
 with this program. If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <cassert>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <format>
 #include <iostream>
-#include <stdexcept>
-#include <syncstream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <tbb/tbb.h>
 
+#include "benchmark.h"
+#include "buffer_pool.h"
+#include "decode_cache.h"
+#include "file_source.h"
+#include "image.h"
+#include "kernels.h"
+#include "memo.h"
+#include "mosaic.h"
+#include "preview.h"
+#include "trace.h"
+#include "tuner.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-#include "sixel.h"
-
 using namespace std::literals;
 
-struct Image {
-  unsigned char* data_ = nullptr;
-  int width_ = 0;
-  int height_ = 0;
-  int channels_ = 0;
-
-  Image() {}
-
-  Image(std::string const& filename) { open(filename); }
-
-  Image(int width, int height, int channels) : width_(width), height_(height), channels_(channels) {
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
-    std::memset(data_, 0x00, size);
+// apply an in-place operation to the image if the caller holds the only reference to it, or to a copy otherwise
+template <typename Operation>
+std::shared_ptr<Image> modify(std::shared_ptr<Image> const& img, Operation&& operation) {
+  if (img.use_count() == 1) {
+    operation(*img);
+    img->hash_ = 0;
+    return img;
   }
+  auto copy = std::make_shared<Image>(*img);
+  operation(*copy);
+  copy->hash_ = 0;
+  return copy;
+}
 
-  ~Image() { close(); }
-
-  // copy constructor
-  Image(Image const& img) : width_(img.width_), height_(img.height_), channels_(img.channels_) {
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
-    std::memcpy(data_, img.data_, size);
+// apply an RGB tint to a shared image, in place if possible; the images without colour channels are tinted into new
+// RGB or RGBA images
+std::shared_ptr<Image> tint(std::shared_ptr<Image> const& img, int r, int g, int b) {
+  if (img->channels_ < 3) {
+    return std::make_shared<Image>(colorize(*img, r, g, b));
   }
+  return modify(img, [=](Image& img) { tint_inplace(img, r, g, b); });
+}
 
-  // copy assignment
-  Image& operator=(Image const& img) {
-    // avoid self-copies
-    if (&img == this) {
-      return *this;
-    }
+// an image in the flow graph, tagged with the id of the input image it derives from; the id travels with the message
+// rather than with the image, because the StageCache hands out the same image to all the inputs with the same content
+struct ImageMsg {
+  int id;
+  std::shared_ptr<Image> image;
+};
 
-    // free any existing image data
-    close();
+// the input image processed by a flow graph node, for the traces and to match the images in the joins
+inline int input_id(ImageMsg const& msg) { return msg.id; }
 
-    width_ = img.width_;
-    height_ = img.height_;
-    channels_ = img.channels_;
-    size_t size = width_ * height_ * channels_;
-    data_ = static_cast<unsigned char*>(stbi__malloc(size));
-    std::memcpy(data_, img.data_, size);
+template <typename... Msgs>
+int input_id(std::tuple<ImageMsg, Msgs...> const& msgs) {
+  return std::get<0>(msgs).id;
+}
 
-    return *this;
-  }
+// the images carried by one or more messages
+inline std::shared_ptr<Image> const& images(ImageMsg const& msg) { return msg.image; }
 
-  // move constructor
-  Image(Image&& img) : data_(img.data_), width_(img.width_), height_(img.height_), channels_(img.channels_) {
-    // take owndership of the image data
-    img.data_ = nullptr;
-  }
+template <typename... Msgs>
+auto images(std::tuple<Msgs...> const& msgs) {
+  return std::apply([](auto const&... msg) { return std::make_tuple(msg.image...); }, msgs);
+}
 
-  // move assignment
-  Image& operator=(Image&& img) {
-    // avoid self-moves
-    if (&img == this) {
-      return *this;
+// wrap the body of a flow graph node, to record its execution and to pass the id of the input image along: the body
+// sees only the images, and the node returns its result tagged with the id, or just the id if there is no result
+template <typename Body>
+auto traced(const char* name, Body body) {
+  return [name, body](auto const& input) {
+    int id = input_id(input);
+    TraceScope trace(name, id);
+    if constexpr (std::is_void_v<decltype(body(images(input)))>) {
+      body(images(input));
+      return id;
+    } else {
+      return ImageMsg{id, body(images(input))};
     }
+  };
+}
 
-    // free any existing image data
-    close();
-
-    // copy the image properties
-    width_ = img.width_;
-    height_ = img.height_;
-    channels_ = img.channels_;
-
-    // take owndership of the image data
-    data_ = img.data_;
-    img.data_ = nullptr;
-
-    return *this;
+int main(int argc, const char* argv[]) {
+  const char* verbose_env = std::getenv("VERBOSE");
+  if (verbose_env != nullptr and std::strlen(verbose_env) != 0) {
+    verbose = true;
   }
 
-  void open(std::string const& filename) {
-    std::osyncstream out(std::cout);
-
-    data_ = stbi_load(filename.c_str(), &width_, &height_, &channels_, 0);
-    if (data_ == nullptr) {
-      throw std::runtime_error("Failed to load "s + filename);
+  // image files, directories, or "-" to read a list of files from the standard input
+  std::vector<std::string> files;
+  if (argc == 1) {
+    // no arguments, use a single default image
+    files = {"image.png"s};
+  } else {
+    files.reserve(argc - 1);
+    for (int i = 1; i < argc; ++i) {
+      files.emplace_back(argv[i]);
     }
-    out << "Loaded image with " << width_ << " x " << height_ << " pixels and " << channels_ << " channels from "
-              << filename << '\n';
   }
 
-  void write(std::string const& filename) {
-    if (filename.ends_with(".png")) {
-      int status = stbi_write_png(filename.c_str(), width_, height_, channels_, data_, 0);
-      if (status == 0) {
-        throw std::runtime_error("Error while writing PNG file "s + filename);
-      }
-    } else if (filename.ends_with(".jpg") or filename.ends_with(".jpeg")) {
-      int status = stbi_write_jpg(filename.c_str(), width_, height_, channels_, data_, 95);
-      if (status == 0) {
-        throw std::runtime_error("Error while writing JPEG file "s + filename);
+  // compare the kernels and the pipelines instead of running the flow graph
+  const char* benchmark_env = std::getenv("BENCHMARK");
+  if (benchmark_env != nullptr and std::strlen(benchmark_env) != 0) {
+    int repetitions = std::max(std::atoi(benchmark_env), 1);
+
+    // run the large tiled pipeline on 15360 x 8640 pixels, or on the size given by BENCHMARK_TILED as
+    // <width>x<height>; for example, the gigapixel 30720x17280 needs about 5 GB of scratch space for RGBA images
+    int tiled_width = 15360;
+    int tiled_height = 8640;
+    const char* tiled_env = std::getenv("BENCHMARK_TILED");
+    if (tiled_env != nullptr and std::strlen(tiled_env) != 0) {
+      if (std::sscanf(tiled_env, "%dx%d", &tiled_width, &tiled_height) != 2 or tiled_width < 2 or tiled_height < 2) {
+        std::cerr << "Invalid tiled benchmark size " << tiled_env << ", use <width>x<height>\n";
+        return 1;
       }
-    } else {
-      throw std::runtime_error("File format "s + filename + "not supported"s);
     }
-  }
 
-  void close() {
-    if (data_ != nullptr) {
-      stbi_image_free(data_);
+    benchmark_open(repetitions);
+    for (auto const& filename : files) {
+      Image img(filename);
+      benchmark_scale(img, repetitions);
+      benchmark_simd(img, repetitions);
+      benchmark_mosaic(img, repetitions);
+      benchmark_composite(img, repetitions);
+      benchmark_tiled(img, repetitions, tiled_width, tiled_height);
+      benchmark_write(img, repetitions);
     }
-    data_ = nullptr;
-  }
-
-  static int sixel_write(char* data, int size, void* priv) {
-    // callback for output sixel
-    return fwrite(data, 1, size, (FILE*)priv);
+    return 0;
   }
 
-  // show an image on the terminal
-  void show() {
-    if (data_ == nullptr) {
-      return;
+  // run the staged pipeline (the default), or the fused one with PIPELINE=fused
+  bool fused = false;
+  const char* pipeline_env = std::getenv("PIPELINE");
+  if (pipeline_env != nullptr and std::strlen(pipeline_env) != 0) {
+    if (pipeline_env == "fused"s) {
+      fused = true;
+    } else if (pipeline_env != "staged"s) {
+      std::cerr << "Unknown pipeline " << pipeline_env << ", use \"staged\" or \"fused\"\n";
+      return 1;
     }
-
-    sixel_output_t* output = nullptr;
-    auto status = sixel_output_new(&output, sixel_write, stdout, nullptr);
-    if (SIXEL_FAILED(status))
-      exit(EXIT_FAILURE);
-
-    sixel_dither_t* dither = sixel_dither_get(SIXEL_BUILTIN_XTERM256);
-    if (channels_ == 1) {
-      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_G8);
-    } else if (channels_ == 3) {
-      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_RGB888);
-    } else if (channels_ == 4) {
-      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_RGBA8888);
-    }
-
-    status = sixel_encode(data_, width_, height_, 0, dither, output);
-    if (SIXEL_FAILED(status))
-      exit(EXIT_FAILURE);
-  }
-};
-
-bool verbose = true;
-
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
-  if (width == src.width_ and height == src.height_) {
-    // if the dimensions are the same, return a copy of the image
-    return src;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
-  auto start = std::chrono::steady_clock::now();
-
-  tbb::parallel_for(
-      tbb::blocked_range2d<int, int>{0, height, 16, 0, width, 16},
-      [&](tbb::blocked_range2d<int, int> const& range) {
-        for (int y = range.rows().begin(); y < range.rows().end(); ++y) {
-          // map the row of the scaled image to the nearest rows of the original image
-          float yp = static_cast<float>(y) * src.height_ / height;
-          int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
-          int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
-
-          // interpolate between y0 and y1
-          float wy0 = yp - y0;
-          float wy1 = y1 - yp;
-          // if the new y coorindate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-          if (y0 == y1) {
-            wy0 = 1.f;
-            wy1 = 1.f;
-          }
-          float dy = wy0 + wy1;
-
-          for (int x = range.cols().begin(); x < range.cols().end(); ++x) {
-            int p = (y * out.width_ + x) * out.channels_;
-
-            // map the column of the scaled image to the nearest columns of the original image
-            float xp = static_cast<float>(x) * src.width_ / width;
-            int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
-            int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
-
-            // interpolate between x0 and x1
-            float wx0 = xp - x0;
-            float wx1 = x1 - xp;
-            // if the new x coordinate maps to an integer coordinate in the original image, use a fake distance from identical values corresponding to it
-            if (x0 == x1) {
-              wx0 = 1.f;
-              wx1 = 1.f;
-            }
-            float dx = wx0 + wx1;
-
-            // bi-linear interpolation of all channels
-            int p00 = (y0 * src.width_ + x0) * src.channels_;
-            int p10 = (y1 * src.width_ + x0) * src.channels_;
-            int p01 = (y0 * src.width_ + x1) * src.channels_;
-            int p11 = (y1 * src.width_ + x1) * src.channels_;
-
-            for (int c = 0; c < src.channels_; ++c) {
-              out.data_[p + c] = static_cast<unsigned char>(
-                  std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                              src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
-                             (dx * dy)));
-            }
-          }
-        }
-      },
-      tbb::simple_partitioner());
-
-  auto finish = std::chrono::steady_clock::now();
-  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  if (verbose) {
-    std::cerr << std::format("scale:      {:6.2f}", ms) << " ms\n";
-  }
-
-  return out;
-}
-
-// copy a source image into a target image, cropping any parts that fall outside the target image
-void write_to(Image const& src, Image& dst, int x, int y) {
-  // copying to an image with a different number of channels is not supported
-  assert(src.channels_ == dst.channels_);
-
-  // the whole source image would fall outside of the target image along the X axis
-  if ((x + src.width_ < 0) or (x >= dst.width_)) {
-    return;
+  // keep the grayscale images in the input format (the default), or convert them to single-channel images with
+  // GRAYSCALE=single; in that case the tinted images and the final mosaic are RGB images
+  bool single_channel = false;
+  const char* grayscale_env = std::getenv("GRAYSCALE");
+  if (grayscale_env != nullptr and std::strlen(grayscale_env) != 0) {
+    if (grayscale_env == "single"s) {
+      single_channel = true;
+    } else if (grayscale_env != "input"s) {
+      std::cerr << "Unknown grayscale format " << grayscale_env << ", use \"input\" or \"single\"\n";
+      return 1;
+    }
   }
 
-  // the whole source image would fall outside of the target image along the Y axis
-  if ((y + src.height_ < 0) or (y >= dst.height_)) {
-    return;
+  // limit the number of images being processed at the same time, to run large batches in a fixed memory budget: by
+  // default twice the number of threads, or the value of IN_FLIGHT
+  int in_flight = 2 * tbb::info::default_concurrency();
+  const char* in_flight_env = std::getenv("IN_FLIGHT");
+  if (in_flight_env != nullptr and std::strlen(in_flight_env) != 0) {
+    in_flight = std::max(std::atoi(in_flight_env), 1);
   }
 
-  // find the valid range for the overlapping part of the images along the X and Y axes
-  int src_x_from = std::max(0, -x);
-  int src_x_to = std::min(src.width_, dst.width_ - x);
-  int dst_x_from = std::max(0, x);
-  //int dst_x_to   = std::min(src.width_ + x, dst.width_);
-  int x_width = src_x_to - src_x_from;
-
-  int src_y_from = std::max(0, -y);
-  int src_y_to = std::min(src.height_, dst.height_ - y);
-  int dst_y_from = std::max(0, y);
-  //int dst_y_to   = std::min(src.height_ + y, dst.height_);
-  int y_height = src_y_to - src_y_from;
-
-  auto start = std::chrono::steady_clock::now();
-
-  tbb::parallel_for<int>(0, y_height, 1, [&](int y) {
-    int src_p = ((src_y_from + y) * src.width_ + src_x_from) * src.channels_;
-    int dst_p = ((dst_y_from + y) * dst.width_ + dst_x_from) * dst.channels_;
-    std::memcpy(dst.data_ + dst_p, src.data_ + src_p, x_width * src.channels_);
-  });
-
-  auto finish = std::chrono::steady_clock::now();
-  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  if (verbose) {
-    std::cerr << std::format("write_to:   {:6.2f}", ms) << " ms\n";
+  // number of files to read ahead of the ones being decoded: by default 4, or the value of PREFETCH
+  int prefetch = 4;
+  const char* prefetch_env = std::getenv("PREFETCH");
+  if (prefetch_env != nullptr and std::strlen(prefetch_env) != 0) {
+    prefetch = std::max(std::atoi(prefetch_env), 0);
   }
-}
 
-// convert an image to grayscale
-Image grayscale(Image const& src) {
-  // non-RGB images are not supported
-  assert(src.channels_ >= 3);
-
-  auto start = std::chrono::steady_clock::now();
-
-  Image dst = src;
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r = dst.data_[p];
-      int g = dst.data_[p + 1];
-      int b = dst.data_[p + 2];
-      // NTSC values for RGB to grayscale conversion
-      int y = (299 * r + 587 * g + 114 * b) / 1000;
-      dst.data_[p] = y;
-      dst.data_[p + 1] = y;
-      dst.data_[p + 2] = y;
+  // load the images from a memory mapping of the files (the default), or with LOADER=read or LOADER=stdio
+  void (Image::*loader)(std::string const&) = &Image::open_mmap;
+  const char* loader_env = std::getenv("LOADER");
+  if (loader_env != nullptr and std::strlen(loader_env) != 0) {
+    if (loader_env == "read"s) {
+      loader = &Image::open;
+    } else if (loader_env == "stdio"s) {
+      loader = &Image::open_stdio;
+    } else if (loader_env != "mmap"s) {
+      std::cerr << "Unknown loader " << loader_env << ", use \"mmap\", \"read\" or \"stdio\"\n";
+      return 1;
     }
-  });
-
-  auto finish = std::chrono::steady_clock::now();
-  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  if (verbose) {
-    std::cerr << std::format("grayscale:  {:6.2f}", ms) << " ms\n";
   }
 
-  return dst;
-}
-
-// apply an RGB tint to an image
-Image tint(Image const& src, int r, int g, int b) {
-  // non-RGB images are not supported
-  assert(src.channels_ >= 3);
-
-  auto start = std::chrono::steady_clock::now();
-
-  Image dst = src;
-
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r0 = dst.data_[p];
-      int g0 = dst.data_[p + 1];
-      int b0 = dst.data_[p + 2];
-      dst.data_[p] = r0 * r / 255;
-      dst.data_[p + 1] = g0 * g / 255;
-      dst.data_[p + 2] = b0 * b / 255;
+  // keep the decoded images in an on-disk cache with CACHE=<directory>, using up to 1024 MB or the value of CACHE_SIZE
+  std::unique_ptr<DecodeCache> cache;
+  const char* cache_env = std::getenv("CACHE");
+  if (cache_env != nullptr and std::strlen(cache_env) != 0) {
+    double cache_size = 1024.;
+    const char* cache_size_env = std::getenv("CACHE_SIZE");
+    if (cache_size_env != nullptr and std::strlen(cache_size_env) != 0) {
+      cache_size = std::atof(cache_size_env);
+      if (cache_size <= 0.) {
+        std::cerr << "Invalid cache size " << cache_size_env << ", use a positive number of MB\n";
+        return 1;
+      }
+    }
+    try {
+      cache = std::make_unique<DecodeCache>(cache_env, static_cast<size_t>(cache_size * 1024 * 1024));
+    } catch (std::filesystem::filesystem_error const& error) {
+      std::cerr << "Cannot use " << cache_env << " as the decode cache: " << error.what() << '\n';
+      return 1;
     }
-  });
-
-  auto finish = std::chrono::steady_clock::now();
-  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  if (verbose) {
-    std::cerr << std::format("tint:       {:6.2f}", ms) << " ms\n";
   }
 
-  return dst;
-}
-
-int main(int argc, const char* argv[]) {
-  const char* verbose_env = std::getenv("VERBOSE");
-  if (verbose_env != nullptr and std::strlen(verbose_env) != 0) {
-    verbose = true;
+  // memoize the results of the stages by content address with MEMO=<MB>, keeping them also in the decode cache if any
+  std::unique_ptr<StageCache<Image>> memo;
+  const char* memo_env = std::getenv("MEMO");
+  if (memo_env != nullptr and std::strlen(memo_env) != 0) {
+    double memo_size = std::atof(memo_env);
+    if (memo_size <= 0.) {
+      std::cerr << "Invalid memoization cache size " << memo_env << ", use a positive number of MB\n";
+      return 1;
+    }
+    memo = std::make_unique<StageCache<Image>>(static_cast<size_t>(memo_size * 1024 * 1024), cache.get());
   }
 
-  std::vector<std::string> files;
-  if (argc == 1) {
-    // no arguments, use a single default image
-    files = {"image.png"s};
-  } else {
-    files.reserve(argc - 1);
-    for (int i = 1; i < argc; ++i) {
-      files.emplace_back(argv[i]);
+  // show at most 10 images per second on the terminal, or the value of PREVIEW
+  double fps = 10.;
+  const char* preview_env = std::getenv("PREVIEW");
+  if (preview_env != nullptr and std::strlen(preview_env) != 0) {
+    fps = std::atof(preview_env);
+    if (fps <= 0.) {
+      std::cerr << "Invalid preview rate " << preview_env << ", use a positive number of images per second\n";
+      return 1;
     }
   }
+  Preview preview(fps);
 
-  // count how many images have been processed
+  // count how many images have been read, and how many have been processed
+  std::atomic<int> next_id = 0;
   std::atomic<int> counter = 0;
 
   // create a TBB flow graph
@@ -384,91 +273,225 @@ int main(int argc, const char* argv[]) {
   // create the graph nodes
   using ImagePtr = std::shared_ptr<Image>;
   using ImageCmb = std::tuple<ImagePtr, ImagePtr, ImagePtr, ImagePtr>;
+  using MsgCmb = std::tuple<ImageMsg, ImageMsg, ImageMsg, ImageMsg>;
+
+  FileSource source(files, prefetch);
+  tbb::flow::input_node<std::string> node_files(  // produce the input files one at a time, as they can be processed
+      graph,
+      [&source](tbb::flow_control& control) -> std::string {
+        std::string filename;
+        if (not source.next(filename)) {
+          control.stop();
+        }
+        return filename;
+      });
 
-  tbb::flow::function_node<std::string, ImagePtr> node_open(  // read the image from a file
+  tbb::flow::limiter_node<std::string> node_limit(graph, in_flight);  // let a limited number of images in at a time
+
+  tbb::flow::function_node<std::string, ImageMsg> node_open(  // read the image from a file
       graph,
       tbb::flow::unlimited,
-      [](std::string filename) -> ImagePtr { return std::make_shared<Image>(filename); });
+      [loader, &cache, &memo, &next_id](std::string filename) -> ImageMsg {
+        int id = next_id++;
+        TraceScope trace("open", id);
+        auto img = std::make_shared<Image>();
+        // on a cache hit, map the decoded pixels instead of decoding the file
+        if (not cache or not cache->load(filename, *img)) {
+          ((*img).*loader)(filename);
+          if (cache) {
+            cache->store(filename, *img);
+          }
+        }
+        // the memoized stages are keyed by the content of the images, rather than by the name of the files
+        if (memo) {
+          TraceScope trace("hash");
+          img->hash_ = content_hash(*img);
+        }
+        return {id, img};
+      });
 
-  tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_show(  // render the image on the terminal
+  tbb::flow::function_node<ImageMsg, int> node_show_input(  // render the input on the terminal
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) { img->show(); });
+      traced("show input", [&preview](ImagePtr img) { preview.push(img); }));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_scale(  // scale down the image to 0.5x0.5
+  tbb::flow::function_node<ImageMsg, int> node_show(  // render the image on the terminal
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr {
-        return std::make_shared<Image>(scale(*img, img->width_ * 0.5, img->height_ * 0.5));
-      });
+      traced("show", [&preview](ImagePtr img) { preview.push(img); }));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_gray(  // generate a grayscale image
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_scale(  // scale down the image to 0.5x0.5
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(grayscale(*img)); });
+      traced("scale",
+             memoized(memo.get(), "scale", {1, 2, static_cast<int>(Filter::Box)}, [](ImagePtr img) -> ImagePtr {
+               return std::make_shared<Image>(scale(*img, img->width_ * 0.5, img->height_ * 0.5, Filter::Box));
+             })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint1(  // apply a purple-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_gray(  // generate a grayscale image
+      graph,
+      tbb::flow::unlimited,
+      traced("grayscale",
+             memoized(memo.get(), "grayscale", {single_channel}, [single_channel](ImagePtr const& img) -> ImagePtr {
+               if (single_channel) {
+                 return std::make_shared<Image>(luminance(*img));
+               }
+               return modify(img, [](Image& img) { grayscale_inplace(img); });
+             })));
+
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint1(  // apply a purple-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 168, 56, 172)); });
+      traced("tint", memoized(memo.get(), "tint", {168, 56, 172}, [](ImagePtr const& img) -> ImagePtr {
+        return tint(img, 168, 56, 172);
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint2(  // apply a green-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint2(  // apply a green-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 100, 143, 47)); });
+      traced("tint", memoized(memo.get(), "tint", {100, 143, 47}, [](ImagePtr const& img) -> ImagePtr {
+        return tint(img, 100, 143, 47);
+      })));
 
-  tbb::flow::function_node<ImagePtr, ImagePtr> node_tint3(  // apply a gold-ish tint
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_tint3(  // apply a gold-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 255, 162, 36)); });
+      traced("tint", memoized(memo.get(), "tint", {255, 162, 36}, [](ImagePtr const& img) -> ImagePtr {
+        return tint(img, 255, 162, 36);
+      })));
 
-  tbb::flow::join_node<ImageCmb, tbb::flow::queueing> node_join(graph);
+  // the images from the same input are matched by their id, as several inputs can be in flight at the same time
+  auto image_id = [](ImageMsg const& msg) { return msg.id; };
+  tbb::flow::join_node<MsgCmb, tbb::flow::key_matching<int>> node_join(graph, image_id, image_id, image_id, image_id);
 
-  tbb::flow::function_node<ImageCmb, ImagePtr> node_result(  // combine the images
+  tbb::flow::function_node<MsgCmb, ImageMsg> node_result(  // combine the images
       graph,
       tbb::flow::unlimited,
-      [](ImageCmb images) -> ImagePtr {
+      traced("combine", memoized(memo.get(), "combine", {}, [](ImageCmb images) -> ImagePtr {
         int width = std::get<0>(images)->width_;
         int height = std::get<0>(images)->height_;
         int channels = std::get<0>(images)->channels_;
         Image out(width * 2, height * 2, channels);
-        write_to(*std::get<0>(images), out, 0, 0);
-        write_to(*std::get<1>(images), out, width, 0);
-        write_to(*std::get<2>(images), out, 0, height);
-        write_to(*std::get<3>(images), out, width, height);
+        composite(out,
+                  {{std::get<0>(images).get(), 0, 0},
+                   {std::get<1>(images).get(), width, 0},
+                   {std::get<2>(images).get(), 0, height},
+                   {std::get<3>(images).get(), width, height}});
         return std::make_shared<Image>(std::move(out));
-      });
+      })));
+
+  // the fused stage depends on the scaling ratio, on the filter, on the grayscale format and on the tints
+  std::vector<int> mosaic_parameters = {1, 2, static_cast<int>(Filter::Box), single_channel};
+  for (auto const& color : tints) {
+    mosaic_parameters.insert(mosaic_parameters.end(), {color.r, color.g, color.b});
+  }
 
-  tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_write(  // write the image to a file
+  tbb::flow::function_node<ImageMsg, ImageMsg> node_mosaic(  // scale, convert, tint and combine the images in one pass
       graph,
       tbb::flow::unlimited,
-      [&counter](ImagePtr img) {
+      traced("mosaic", memoized(memo.get(), "mosaic", mosaic_parameters, [single_channel](ImagePtr img) -> ImagePtr {
+        return std::make_shared<Image>(
+            mosaic(*img, img->width_ * 0.5, img->height_ * 0.5, Filter::Box, tints, single_channel));
+      })));
+
+  tbb::flow::function_node<ImageMsg, int> node_write(  // write the image to a file
+      graph,
+      tbb::flow::unlimited,
+      traced("write", [&counter](ImagePtr img) {
         std::string filename = std::format("out{:02d}.jpg", counter++);
         img->write(filename);
-      });
+      }));
 
-  // create the graph edges
-  tbb::flow::make_edge(node_open, node_show);
-  tbb::flow::make_edge(node_open, node_scale);
-  tbb::flow::make_edge(node_scale, node_gray);
-  tbb::flow::make_edge(node_gray, node_tint1);
-  tbb::flow::make_edge(node_gray, node_tint2);
-  tbb::flow::make_edge(node_gray, node_tint3);
-  tbb::flow::make_edge(node_tint1, tbb::flow::input_port<0>(node_join));
-  tbb::flow::make_edge(node_tint2, tbb::flow::input_port<1>(node_join));
-  tbb::flow::make_edge(node_tint3, tbb::flow::input_port<2>(node_join));
-  tbb::flow::make_edge(node_gray, tbb::flow::input_port<3>(node_join));
-  tbb::flow::make_edge(node_join, node_result);
-  tbb::flow::make_edge(node_result, node_show);
-  tbb::flow::make_edge(node_result, node_write);
+  // each node reports the id of the image it has completed, so that the limiter is decremented only once all three
+  // nodes are done with the same image
+  using DoneCmb = std::tuple<int, int, int>;
+  auto done_id = [](int id) { return id; };
+  tbb::flow::join_node<DoneCmb, tbb::flow::key_matching<int>> node_join_done(graph, done_id, done_id, done_id);
 
-  // send data through the graph
-  for (auto const& filename : files) {
-    node_open.try_put(filename);
+  tbb::flow::function_node<DoneCmb, tbb::flow::continue_msg> node_done(  // an image has been shown and written
+      graph,
+      tbb::flow::serial,
+      [](DoneCmb) { return tbb::flow::continue_msg(); });
+
+  // create the graph edges; once an image has been shown and written the limiter lets the next one through, so
+  // none of its buffers can be held by a pending node
+  tbb::flow::make_edge(node_files, node_limit);
+  tbb::flow::make_edge(node_limit, node_open);
+  tbb::flow::make_edge(node_open, node_show_input);
+  tbb::flow::make_edge(node_show_input, tbb::flow::input_port<0>(node_join_done));
+  tbb::flow::make_edge(node_show, tbb::flow::input_port<1>(node_join_done));
+  tbb::flow::make_edge(node_write, tbb::flow::input_port<2>(node_join_done));
+  tbb::flow::make_edge(node_join_done, node_done);
+  tbb::flow::make_edge(node_done, node_limit.decrementer());
+  if (fused) {
+    tbb::flow::make_edge(node_open, node_mosaic);
+    tbb::flow::make_edge(node_mosaic, node_show);
+    tbb::flow::make_edge(node_mosaic, node_write);
+  } else {
+    tbb::flow::make_edge(node_open, node_scale);
+    tbb::flow::make_edge(node_scale, node_gray);
+    tbb::flow::make_edge(node_gray, node_tint1);
+    tbb::flow::make_edge(node_gray, node_tint2);
+    tbb::flow::make_edge(node_gray, node_tint3);
+    tbb::flow::make_edge(node_tint1, tbb::flow::input_port<0>(node_join));
+    tbb::flow::make_edge(node_tint2, tbb::flow::input_port<1>(node_join));
+    tbb::flow::make_edge(node_tint3, tbb::flow::input_port<2>(node_join));
+    tbb::flow::make_edge(node_gray, tbb::flow::input_port<3>(node_join));
+    tbb::flow::make_edge(node_join, node_result);
+    tbb::flow::make_edge(node_result, node_show);
+    tbb::flow::make_edge(node_result, node_write);
   }
 
-  // wait for all operation to complete
+  // send data through the graph
+  node_files.activate();
+
+  // wait for all operation to complete, and for the preview to catch up
   graph.wait_for_all();
+  preview.stop();
+
+  // write the trace of the nodes and kernels, if enabled with TRACE=<file.json>
+  TraceRecorder::instance().dump();
+
+  // save the grain sizes and partitioners tuned during this run, if enabled with TUNING=<file>
+  Tuner::instance().save(verbose);
+
+  if (verbose) {
+    std::cerr << std::format("preview: {} images shown, {} dropped", preview.shown(), preview.dropped()) << '\n';
+
+    auto stats = BufferPool::instance().stats();
+    std::cerr << std::format("buffer pool: {} hits, {} misses, {:.2f} MB peak resident, {:.2f} MB cached",
+                             stats.hits,
+                             stats.misses,
+                             stats.peak / 1.e6,
+                             stats.cached / 1.e6)
+              << '\n';
+
+    if (memo) {
+      auto stats = memo->stats();
+      std::cerr << std::format("stage cache: {} hits, {} from disk, {} misses",
+                               stats.hits,
+                               stats.disk_hits,
+                               stats.misses)
+                << '\n';
+    }
+
+    if (cache) {
+      auto stats = cache->stats();
+      std::cerr << std::format("decode cache: {} hits, {} misses, {} evictions",
+                               stats.hits,
+                               stats.misses,
+                               stats.evictions)
+                << '\n';
+    }
+
+    // high-water mark of the memory used by the whole process
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cerr << std::format("memory: {:.2f} MB peak resident set size, with up to {} images in flight",
+                             usage.ru_maxrss / 1.e3,
+                             in_flight)
+              << '\n';
+  }
 
   return 0;
 }
@@ -0,0 +1,147 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef buffer_pool_h
+#define buffer_pool_h
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <tbb/tbb.h>
+
+// thread-safe pool of 64-byte aligned pixel buffers, grouped in size classes: the buffers released by the images are
+// kept in a lock-free free list per size class, and reused by the next images of a similar size; the free lists hold
+// up to 256 MB, or the value of POOL_SIZE in MB, and any buffer released beyond that is given back to the system
+class BufferPool {
+public:
+  static constexpr size_t alignment = 64;
+
+  struct Stats {
+    size_t hits;
+    size_t misses;
+    size_t resident;
+    size_t peak;
+    size_t cached;
+  };
+
+  static BufferPool& instance() {
+    static BufferPool pool;
+    return pool;
+  }
+
+  ~BufferPool() {
+    for (auto& buffers : free_) {
+      unsigned char* data = nullptr;
+      while (buffers.try_pop(data)) {
+        std::free(data);
+      }
+    }
+  }
+
+  // return a buffer of at least size bytes, reusing a free one of the same size class if possible
+  unsigned char* acquire(size_t size) {
+    int index = size_class(size);
+    unsigned char* data = nullptr;
+    if (free_[index].try_pop(data)) {
+      ++hits_;
+      cached_ -= class_size(index);
+      return data;
+    }
+
+    ++misses_;
+    size_t bytes = class_size(index);
+    data = static_cast<unsigned char*>(std::aligned_alloc(alignment, bytes));
+    if (data == nullptr) {
+      throw std::bad_alloc();
+    }
+    size_t resident = resident_ += bytes;
+    size_t peak = peak_.load();
+    while (resident > peak and not peak_.compare_exchange_weak(peak, resident)) {
+    }
+    return data;
+  }
+
+  // give back a buffer obtained from acquire(size), keeping it for reuse if the free lists have room for it
+  void release(unsigned char* data, size_t size) {
+    int index = size_class(size);
+    size_t bytes = class_size(index);
+    if ((cached_ += bytes) > max_cached_) {
+      cached_ -= bytes;
+      resident_ -= bytes;
+      std::free(data);
+      return;
+    }
+    free_[index].push(data);
+  }
+
+  Stats stats() const {
+    return Stats{hits_.load(), misses_.load(), resident_.load(), peak_.load(), cached_.load()};
+  }
+
+private:
+  BufferPool() {
+    const char* size_env = std::getenv("POOL_SIZE");
+    if (size_env == nullptr or std::strlen(size_env) == 0) {
+      return;
+    }
+    double size = std::atof(size_env);
+    if (size < 0.) {
+      std::cerr << "Invalid buffer pool size " << size_env << ", using the default of " << (max_cached_ >> 20)
+                << " MB\n";
+      return;
+    }
+    max_cached_ = static_cast<size_t>(size * 1024 * 1024);
+  }
+
+  // four size classes for each power of two, so at most 25% of each buffer is wasted; the smallest class is 4 kB
+  static constexpr size_t min_size = 4096;
+  static constexpr int classes = 4 * 64;
+
+  static int size_class(size_t size) {
+    size = std::max(size, min_size);
+    // size is in the range (2^(e-1), 2^e], split in four classes of width 2^(e-3)
+    int e = std::bit_width(size - 1);
+    size_t base = size_t{1} << (e - 1);
+    size_t step = size_t{1} << (e - 3);
+    int q = (size - base + step - 1) / step;
+    return e * 4 + q - 1;
+  }
+
+  static size_t class_size(int index) {
+    int e = index / 4;
+    int q = index % 4 + 1;
+    return (size_t{1} << (e - 1)) + q * (size_t{1} << (e - 3));
+  }
+
+  std::array<tbb::concurrent_queue<unsigned char*>, classes> free_;
+  std::atomic<size_t> hits_ = 0;
+  std::atomic<size_t> misses_ = 0;
+  std::atomic<size_t> resident_ = 0;
+  std::atomic<size_t> peak_ = 0;
+  // bytes held in the free lists, and their upper limit
+  std::atomic<size_t> cached_ = 0;
+  size_t max_cached_ = size_t{256} << 20;
+};
+
+#endif  // buffer_pool_h
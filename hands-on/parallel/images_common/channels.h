@@ -0,0 +1,36 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef channels_h
+#define channels_h
+
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// call a kernel templated on the number of channels, passed as a std::integral_constant, for the given runtime number
+// of channels; the dispatch happens once per image, so the per-pixel loops can be unrolled and vectorised
+template <int... Supported, typename Kernel>
+void with_channels(int channels, Kernel&& kernel) {
+  bool found = ((channels == Supported ? (kernel(std::integral_constant<int, Supported>{}), true) : false) or ...);
+  if (not found) {
+    throw std::runtime_error("Images with " + std::to_string(channels) + " channels are not supported");
+  }
+}
+
+#endif  // channels_h
@@ -0,0 +1,154 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef composite_h
+#define composite_h
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "channels.h"
+#include "image.h"
+#include "trace.h"
+
+// a source image placed on a destination image by composite(), with its top-left corner at (x, y); without an alpha
+// value the source pixels replace the destination ones, like write_to(), otherwise they are blended over them with
+// the given opacity, combined with the alpha channel of 4-channel sources
+struct Placement {
+  Image const* image;
+  int x;
+  int y;
+  std::optional<uint8_t> alpha = std::nullopt;
+};
+
+// size of the destination tiles processed by each composite() task: 16 rows of 1024 RGBA pixels fit in the L2 cache,
+// and are long enough for the copies to run at full speed
+constexpr int composite_tile_rows = 16;
+constexpr int composite_tile_cols = 1024;
+
+// copy or blend a row of pixels from a source to a destination with Channels channels; the gray value of the sources
+// without colour channels is expanded to all the colour channels, and the alpha channel of a 4-channel destination is
+// combined with the one of the 2-channel and 4-channel sources
+template <int Channels, int SourceChannels>
+void composite_row(const unsigned char* in, unsigned char* out, int width, std::optional<uint8_t> alpha) {
+  constexpr int colors = Channels == 4 ? 3 : Channels;
+
+  if (not alpha) {
+    if constexpr (SourceChannels == Channels) {
+      std::memcpy(out, in, width * Channels);
+    } else {
+      for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < colors; ++c) {
+          out[x * Channels + c] = in[x * SourceChannels];
+        }
+        if constexpr (Channels == 4) {
+          // source alpha channel, or opaque
+          out[x * Channels + 3] = SourceChannels == 2 ? in[x * SourceChannels + 1] : 255;
+        }
+      }
+    }
+    return;
+  }
+
+  for (int x = 0; x < width; ++x) {
+    const unsigned char* s = in + x * SourceChannels;
+    unsigned char* d = out + x * Channels;
+    // source alpha, scaled by 255 * 255 to avoid rounding it
+    int a = *alpha * (SourceChannels == 4 ? s[3] : SourceChannels == 2 ? s[1] : 255);
+    if (a == 0) {
+      continue;
+    }
+    if constexpr (Channels == 4) {
+      // "over" operator on non-premultiplied colours; the alphas are scaled by 255 * 255 * 255
+      int da = d[3] * (255 * 255 - a);
+      int oa = a * 255 + da;
+      float sw = static_cast<float>(a * 255) / oa;
+      float dw = static_cast<float>(da) / oa;
+      for (int c = 0; c < colors; ++c) {
+        int value = SourceChannels < 3 ? s[0] : s[c];
+        d[c] = static_cast<int>(value * sw + d[c] * dw + 0.5f);
+      }
+      d[3] = (oa + 255 * 255 / 2) / (255 * 255);
+    } else {
+      for (int c = 0; c < colors; ++c) {
+        int value = SourceChannels < 3 ? s[0] : s[c];
+        d[c] = (value * a + d[c] * (255 * 255 - a) + 255 * 255 / 2) / (255 * 255);
+      }
+    }
+  }
+}
+
+// copy or blend several images on the destination one, in the given order, in a single parallel pass over 2D tiles
+// of the destination, so that each part of it is brought into the cache only once; the sources must have the same
+// number of channels as the destination, or a single channel, or two channels for an RGBA destination
+inline void composite(Image& dst, std::vector<Placement> const& placements) {
+  TraceScope trace("composite");
+  for ([[maybe_unused]] auto const& placement : placements) {
+    [[maybe_unused]] int channels = placement.image->channels_;
+    assert(channels == dst.channels_ or channels == 1 or (channels == 2 and dst.channels_ == 4));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  with_channels<1, 3, 4>(dst.channels_, [&](auto channels) {
+    tbb::parallel_for(
+        tbb::blocked_range2d<int>{0, dst.height_, composite_tile_rows, 0, dst.width_, composite_tile_cols},
+        [&](tbb::blocked_range2d<int> const& tile) {
+          for (auto const& placement : placements) {
+            Image const& src = *placement.image;
+            // the part of the tile covered by the source image
+            int x_from = std::max(tile.cols().begin(), placement.x);
+            int x_to = std::min(tile.cols().end(), placement.x + src.width_);
+            int y_from = std::max(tile.rows().begin(), placement.y);
+            int y_to = std::min(tile.rows().end(), placement.y + src.height_);
+            if (x_from >= x_to or y_from >= y_to) {
+              continue;
+            }
+            int src_x = x_from - placement.x;
+            for (int y = y_from; y < y_to; ++y) {
+              size_t src_p = (static_cast<size_t>(y - placement.y) * src.width_ + src_x) * src.channels_;
+              size_t dst_p = (static_cast<size_t>(y) * dst.width_ + x_from) * channels;
+              if (src.channels_ == channels) {
+                composite_row<channels, channels>(src.data_ + src_p, dst.data_ + dst_p, x_to - x_from, placement.alpha);
+              } else if (src.channels_ == 2) {
+                composite_row<channels, 2>(src.data_ + src_p, dst.data_ + dst_p, x_to - x_from, placement.alpha);
+              } else {
+                composite_row<channels, 1>(src.data_ + src_p, dst.data_ + dst_p, x_to - x_from, placement.alpha);
+              }
+            }
+          }
+        });
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << std::format("composite:  {:6.2f}", ms) << " ms\n";
+  }
+}
+
+#endif  // composite_h
@@ -0,0 +1,289 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef decode_cache_h
+#define decode_cache_h
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "memo.h"
+#include "trace.h"
+
+// on-disk cache of the decoded images, to skip decoding the same files again over repeated runs: each entry holds a
+// header and the raw pixels of one image, and is mapped in memory on a hit; the entries are keyed by the path of the
+// file, its size and its modification time, and the least recently used ones are removed when the cache grows beyond
+// its capacity; the results of the flow graph stages are stored in the same cache
+class DecodeCache : public ResultStore<Image> {
+public:
+  struct Stats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+  };
+
+  DecodeCache(std::filesystem::path directory, size_t capacity)
+      : directory_(std::move(directory)), capacity_(capacity) {
+    std::filesystem::create_directories(directory_);
+
+    // resume from the entries left by the previous runs, from the least to the most recently used
+    std::vector<std::pair<std::filesystem::file_time_type, std::string>> entries;
+    for (auto const& entry : std::filesystem::directory_iterator(directory_)) {
+      if (entry.is_regular_file() and entry.path().extension() == ".raw") {
+        entries.emplace_back(entry.last_write_time(), entry.path().filename().string());
+      }
+    }
+    std::sort(entries.begin(), entries.end());
+    for (auto const& [time, name] : entries) {
+      use(name, std::filesystem::file_size(directory_ / name));
+    }
+  }
+
+  // map the cached pixels of filename into img and return true, or return false if the file is not in the cache or
+  // has changed since it was cached
+  bool load(std::string const& filename, Image& img) {
+    TraceScope trace("cache");
+    Key key;
+    if (not make_key(filename, key) or not map(key, img)) {
+      ++misses_;
+      return false;
+    }
+    ++hits_;
+    img.loaded(filename);
+    return true;
+  }
+
+  // write the decoded pixels of filename to the cache, replacing any previous entry for the same file
+  void store(std::string const& filename, Image const& img) {
+    TraceScope trace("cache");
+    Key key;
+    if (make_key(filename, key)) {
+      write(key, img);
+    }
+  }
+
+  // the results of the flow graph stages are cached by their content address; they share the capacity with the
+  // decoded images, but not the statistics
+  bool load(uint64_t address, Image& img) override { return map(stage_key(address), img); }
+
+  void store(uint64_t address, Image const& img) override { write(stage_key(address), img); }
+
+  Stats stats() const { return Stats{hits_.load(), misses_.load(), evictions_.load()}; }
+
+private:
+  // the header is padded to a page, so the pixels of a mapped entry are page-aligned
+  static constexpr size_t header_size = 4096;
+  static constexpr char magic[8] = {'I', 'M', 'G', 'C', 'A', 'C', 'H', 'E'};
+
+  // followed by the path of the file
+  struct Header {
+    char magic[8];
+    uint64_t size;
+    int64_t mtime;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint32_t path_size;
+  };
+
+  struct Key {
+    std::string path;
+    uint64_t size;
+    int64_t mtime;
+  };
+
+  struct Entry {
+    std::list<std::string>::iterator position;
+    size_t size;
+  };
+
+  // map the entry for key into img, if it exists and it is complete
+  bool map(Key const& key, Image& img) {
+    std::string name = entry_name(key);
+    int fd = ::open((directory_ / name).c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 and static_cast<size_t>(info.st_size) > header_size) {
+      // a private, writable mapping lets the kernels modify the image in place without changing the cache entry
+      mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    if (mapping == MAP_FAILED or not matches(static_cast<const char*>(mapping), info.st_size, key)) {
+      if (mapping != MAP_FAILED) {
+        munmap(mapping, info.st_size);
+      }
+      ::close(fd);
+      return false;
+    }
+    // mark the entry as recently used, also for the next runs
+    futimens(fd, nullptr);
+    ::close(fd);
+
+    auto const* header = static_cast<const Header*>(mapping);
+    img.close();
+    img.data_ = static_cast<unsigned char*>(mapping) + header_size;
+    img.width_ = header->width;
+    img.height_ = header->height;
+    img.channels_ = header->channels;
+    img.mapped_ = info.st_size;
+    std::lock_guard<std::mutex> lock(mutex_);
+    use(name, info.st_size);
+    return true;
+  }
+
+  // write img to the entry for key, replacing any previous one
+  void write(Key const& key, Image const& img) {
+    size_t size = static_cast<size_t>(img.width_) * img.height_ * img.channels_;
+    if (sizeof(Header) + key.path.size() > header_size or header_size + size > capacity_) {
+      return;
+    }
+
+    std::vector<char> buffer(header_size, 0);
+    Header header{
+        {}, key.size, key.mtime, img.width_, img.height_, img.channels_, static_cast<uint32_t>(key.path.size())};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+    std::memcpy(buffer.data() + sizeof(Header), key.path.data(), key.path.size());
+
+    // write the entry to a temporary file and rename it, so that a concurrent reader never sees a partial entry
+    std::string name = entry_name(key);
+    std::string temporary = (directory_ / (name + ".XXXXXX")).string();
+    int fd = mkstemp(temporary.data());
+    if (fd < 0) {
+      std::cerr << "Error while creating a decode cache entry in " << directory_.string() << '\n';
+      return;
+    }
+    bool written = write_all(fd, buffer.data(), header_size) and write_all(fd, img.data_, size);
+    written = ::close(fd) == 0 and written;
+    if (not written or std::rename(temporary.c_str(), (directory_ / name).c_str()) != 0) {
+      std::cerr << "Error while writing the decode cache entry for " << key.path << '\n';
+      ::unlink(temporary.c_str());
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    use(name, header_size + size);
+  }
+
+  static bool make_key(std::string const& filename, Key& key) {
+    struct stat info;
+    if (::stat(filename.c_str(), &info) != 0) {
+      return false;
+    }
+    std::error_code error;
+    auto path = std::filesystem::canonical(filename, error);
+    key.path = error ? filename : path.string();
+    key.size = info.st_size;
+    key.mtime = info.st_mtim.tv_sec * 1'000'000'000LL + info.st_mtim.tv_nsec;
+    return true;
+  }
+
+  // the canonical paths of the files are absolute, so they never collide with the keys of the stage results
+  static Key stage_key(uint64_t address) { return Key{std::format("stage:{:016x}", address), 0, 0}; }
+
+  // one entry per path, so a file that has changed replaces its stale entry
+  static std::string entry_name(Key const& key) {
+    return std::format("{:016x}.raw", std::hash<std::string>{}(key.path));
+  }
+
+  // check that a mapped entry is complete, and that it holds the given file
+  static bool matches(const char* mapping, size_t size, Key const& key) {
+    Header header;
+    std::memcpy(&header, mapping, sizeof(Header));
+    return std::memcmp(header.magic, magic, sizeof(magic)) == 0 and header.size == key.size and
+           header.mtime == key.mtime and header.path_size == key.path.size() and
+           sizeof(Header) + header.path_size <= header_size and
+           std::memcmp(mapping + sizeof(Header), key.path.data(), key.path.size()) == 0 and header.width > 0 and
+           header.height > 0 and header.channels > 0 and
+           header_size + static_cast<size_t>(header.width) * header.height * header.channels == size;
+  }
+
+  static bool write_all(int fd, const void* data, size_t size) {
+    auto const* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+      ssize_t written = ::write(fd, bytes, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      bytes += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  // move an entry to the most recently used end of the list, then evict the least recently used ones until the cache
+  // fits in its capacity; the images that have been mapped keep their pixels until they are closed
+  void use(std::string const& name, size_t size) {
+    auto it = entries_.find(name);
+    if (it != entries_.end()) {
+      lru_.splice(lru_.end(), lru_, it->second.position);
+      total_ -= it->second.size;
+      it->second.size = size;
+    } else {
+      entries_.emplace(name, Entry{lru_.insert(lru_.end(), name), size});
+    }
+    total_ += size;
+
+    while (total_ > capacity_ and not lru_.empty()) {
+      auto victim = entries_.find(lru_.front());
+      std::error_code error;
+      std::filesystem::remove(directory_ / lru_.front(), error);
+      total_ -= victim->second.size;
+      entries_.erase(victim);
+      lru_.pop_front();
+      ++evictions_;
+    }
+  }
+
+  std::filesystem::path directory_;
+  size_t capacity_;
+  size_t total_ = 0;
+  std::mutex mutex_;
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::atomic<size_t> hits_ = 0;
+  std::atomic<size_t> misses_ = 0;
+  std::atomic<size_t> evictions_ = 0;
+};
+
+#endif  // decode_cache_h
@@ -0,0 +1,487 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef encode_h
+#define encode_h
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include <zlib.h>
+
+// Parallel encoders: the image is split in horizontal strips, that are compressed independently on the TBB arena and
+// then concatenated into a single, standard-compliant file.
+
+// number of rows in each strip compressed by a separate task
+constexpr int encode_strip_rows = 64;
+
+// append a big-endian 16-bit or 32-bit value
+inline void put_be16(std::vector<unsigned char>& out, unsigned value) {
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+inline void put_be32(std::vector<unsigned char>& out, uint32_t value) {
+  put_be16(out, value >> 16);
+  put_be16(out, value & 0xffff);
+}
+
+// PNG encoder: each row is filtered with the filter that minimises the sum of the absolute values of its bytes, as in
+// libpng; each strip of filtered rows is then compressed into raw DEFLATE blocks that end on a byte boundary
+// (Z_FULL_FLUSH), so the strips can be concatenated into a single zlib stream, whose Adler-32 checksum is combined
+// from the ones of the strips
+inline std::vector<unsigned char> encode_png(const unsigned char* data, int width, int height, int channels) {
+  const size_t row_size = static_cast<size_t>(width) * channels;
+  const size_t line_size = row_size + 1;
+
+  // filter the rows; each output line starts with the filter type
+  std::vector<unsigned char> filtered(line_size * height);
+  tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](tbb::blocked_range<int> const& range) {
+    std::vector<unsigned char> buffer(5 * row_size);
+    for (int y = range.begin(); y < range.end(); ++y) {
+      const unsigned char* row = data + y * row_size;
+      const unsigned char* above = y > 0 ? row - row_size : nullptr;
+      unsigned char* candidates[5] = {buffer.data(),
+                                      buffer.data() + row_size,
+                                      buffer.data() + 2 * row_size,
+                                      buffer.data() + 3 * row_size,
+                                      buffer.data() + 4 * row_size};
+      for (size_t i = 0; i < row_size; ++i) {
+        int a = i >= static_cast<size_t>(channels) ? row[i - channels] : 0;
+        int b = above ? above[i] : 0;
+        int c = (above and i >= static_cast<size_t>(channels)) ? above[i - channels] : 0;
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        int paeth = (pa <= pb and pa <= pc) ? a : (pb <= pc ? b : c);
+        candidates[0][i] = row[i];
+        candidates[1][i] = row[i] - a;
+        candidates[2][i] = row[i] - b;
+        candidates[3][i] = row[i] - (a + b) / 2;
+        candidates[4][i] = row[i] - paeth;
+      }
+      int best = 0;
+      long best_sum = std::numeric_limits<long>::max();
+      for (int f = 0; f < 5; ++f) {
+        long sum = 0;
+        for (size_t i = 0; i < row_size; ++i) {
+          sum += std::abs(static_cast<signed char>(candidates[f][i]));
+        }
+        if (sum < best_sum) {
+          best = f;
+          best_sum = sum;
+        }
+      }
+      unsigned char* line = filtered.data() + y * line_size;
+      line[0] = best;
+      std::memcpy(line + 1, candidates[best], row_size);
+    }
+  });
+
+  // compress the strips
+  int strips = (height + encode_strip_rows - 1) / encode_strip_rows;
+  std::vector<std::vector<unsigned char>> compressed(strips);
+  std::vector<uLong> checksums(strips);
+  tbb::parallel_for<int>(0, strips, 1, [&](int s) {
+    int rows = std::min(encode_strip_rows, height - s * encode_strip_rows);
+    unsigned char* in = filtered.data() + s * encode_strip_rows * line_size;
+    uInt size = rows * line_size;
+    checksums[s] = adler32(adler32(0, nullptr, 0), in, size);
+
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error("Failed to initialise the PNG compression");
+    }
+    auto& out = compressed[s];
+    // leave room for the flush marker
+    out.resize(deflateBound(&stream, size) + 16);
+    stream.next_in = in;
+    stream.avail_in = size;
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+    // the output buffer is large enough for the whole strip, so the last one must end the stream, and the others must
+    // be flushed completely
+    bool last = s == strips - 1;
+    int status = deflate(&stream, last ? Z_FINISH : Z_FULL_FLUSH);
+    deflateEnd(&stream);
+    if (status != (last ? Z_STREAM_END : Z_OK) or stream.avail_in != 0) {
+      throw std::runtime_error("Failed to compress the PNG image data");
+    }
+    out.resize(out.size() - stream.avail_out);
+  });
+
+  // build the zlib stream: header, strips and checksum
+  std::vector<unsigned char> zlib = {0x78, 0x9c};
+  uLong checksum = adler32(0, nullptr, 0);
+  for (int s = 0; s < strips; ++s) {
+    int rows = std::min(encode_strip_rows, height - s * encode_strip_rows);
+    zlib.insert(zlib.end(), compressed[s].begin(), compressed[s].end());
+    checksum = adler32_combine(checksum, checksums[s], rows * line_size);
+  }
+  put_be32(zlib, checksum);
+
+  // write the PNG signature and chunks
+  std::vector<unsigned char> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  auto chunk = [&out](const char* type, const unsigned char* data, size_t size) {
+    put_be32(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, crc32(0, out.data() + start, size + 4));
+  };
+  const unsigned char color_types[] = {0, 0, 4, 2, 6};
+  std::vector<unsigned char> header;
+  put_be32(header, width);
+  put_be32(header, height);
+  header.insert(header.end(), {8, color_types[channels], 0, 0, 0});
+  chunk("IHDR", header.data(), header.size());
+  chunk("IDAT", zlib.data(), zlib.size());
+  chunk("IEND", nullptr, 0);
+  return out;
+}
+
+// JPEG encoder: baseline JPEG with the standard Huffman tables and no chroma subsampling; each strip of 8-pixel rows
+// is a restart interval, that starts with fresh DC predictors and ends on a byte boundary, so the strips can be
+// encoded independently and concatenated with RSTn markers in between
+class JpegEncoder {
+public:
+  JpegEncoder(int quality) {
+    static const unsigned char luminance[64] = {
+        16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,  14, 13, 16, 24, 40,  57,
+        69, 56, 14, 17, 22,  29,  51,  87,  80, 62, 18, 22, 37,  56,  68,  109, 103, 77, 24, 35, 55,  64,
+        81, 104, 113, 92, 49,  64,  78,  87,  103, 121, 120, 101, 72, 92, 95, 98,  112, 100, 103, 99};
+    static const unsigned char chrominance[64] = {
+        17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99,
+        99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+    // scale the quantisation tables as the IJG library does
+    quality = std::clamp(quality, 1, 100);
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (int i = 0; i < 64; ++i) {
+      quant_[0][i] = std::clamp((luminance[i] * scale + 50) / 100, 1, 255);
+      quant_[1][i] = std::clamp((chrominance[i] * scale + 50) / 100, 1, 255);
+    }
+
+    // the AAN transform computes the DCT coefficients up to a per-coefficient scale factor, that is folded into the
+    // quantisation step
+    static const float aan[8] = {
+        1.f, 1.387039845f, 1.306562965f, 1.175875602f, 1.f, 0.785694958f, 0.541196100f, 0.275899379f};
+    for (int t = 0; t < 2; ++t) {
+      for (int i = 0; i < 64; ++i) {
+        scale_[t][i] = 1.f / (quant_[t][i] * aan[i / 8] * aan[i % 8] * 8.f);
+      }
+    }
+
+    for (int t = 0; t < 4; ++t) {
+      build_codes(tables[t].bits, tables[t].values, codes_[t]);
+    }
+  }
+
+  std::vector<unsigned char> encode(const unsigned char* data, int width, int height, int channels) const {
+    const int components = channels >= 3 ? 3 : 1;
+    const int blocks_x = (width + 7) / 8;
+    const int blocks_y = (height + 7) / 8;
+
+    // the restart interval is counted in blocks, and must fit in 16 bits
+    int strip_blocks = std::clamp(encode_strip_rows / 8, 1, std::max(65535 / blocks_x, 1));
+    int strips = (blocks_y + strip_blocks - 1) / strip_blocks;
+
+    std::vector<std::vector<unsigned char>> segments(strips);
+    tbb::parallel_for<int>(0, strips, 1, [&](int s) {
+      BitWriter writer{segments[s]};
+      int dc[3] = {0, 0, 0};
+      for (int by = s * strip_blocks; by < std::min((s + 1) * strip_blocks, blocks_y); ++by) {
+        for (int bx = 0; bx < blocks_x; ++bx) {
+          float block[3][64];
+          load_block(data, width, height, channels, bx * 8, by * 8, block);
+          for (int c = 0; c < components; ++c) {
+            encode_block(writer, block[c], c == 0 ? 0 : 1, dc[c]);
+          }
+        }
+      }
+      writer.flush();
+    });
+
+    std::vector<unsigned char> out = {0xff, 0xd8};
+    write_headers(out, width, height, components, strip_blocks * blocks_x);
+    for (int s = 0; s < strips; ++s) {
+      out.insert(out.end(), segments[s].begin(), segments[s].end());
+      if (s != strips - 1) {
+        out.insert(out.end(), {0xff, static_cast<unsigned char>(0xd0 + s % 8)});
+      }
+    }
+    out.insert(out.end(), {0xff, 0xd9});
+    return out;
+  }
+
+private:
+  // bits[i] is the number of codes of length i + 1, followed by the symbols in order of increasing code length
+  struct HuffmanTable {
+    unsigned char bits[16];
+    std::vector<unsigned char> values;
+  };
+
+  // standard tables from the JPEG specification: DC and AC luminance, DC and AC chrominance
+  static inline const HuffmanTable tables[4] = {
+      {{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}},
+      {{0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},
+       {0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+        0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+        0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+        0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+        0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+        0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}},
+      {{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}},
+      {{0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+       {0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+        0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+        0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+        0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+        0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+        0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+        0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+        0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}}};
+
+  // position in the 8x8 block of the i-th coefficient in zig-zag order
+  static constexpr unsigned char zigzag[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                               12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                               35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                               58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+  // Huffman code and length of each symbol
+  struct Code {
+    uint16_t code = 0;
+    uint8_t length = 0;
+  };
+
+  static void build_codes(const unsigned char* bits, std::vector<unsigned char> const& values, Code* codes) {
+    unsigned code = 0;
+    size_t k = 0;
+    for (int length = 1; length <= 16; ++length) {
+      for (int i = 0; i < bits[length - 1]; ++i) {
+        codes[values[k++]] = {static_cast<uint16_t>(code++), static_cast<uint8_t>(length)};
+      }
+      code <<= 1;
+    }
+  }
+
+  // entropy-coded data, with the 0xff bytes followed by a stuffed 0x00
+  struct BitWriter {
+    std::vector<unsigned char>& out;
+    uint32_t buffer = 0;
+    int count = 0;
+
+    void put(unsigned bits, int length) {
+      buffer = (buffer << length) | (bits & ((1u << length) - 1));
+      count += length;
+      while (count >= 8) {
+        unsigned char byte = buffer >> (count - 8);
+        out.push_back(byte);
+        if (byte == 0xff) {
+          out.push_back(0x00);
+        }
+        count -= 8;
+      }
+    }
+
+    // pad the last byte with 1 bits
+    void flush() {
+      if (count > 0) {
+        put(0x7f, 8 - count);
+      }
+    }
+  };
+
+  // convert an 8x8 block to level-shifted YCbCr, replicating the last row and column past the edges of the image
+  static void load_block(
+      const unsigned char* data, int width, int height, int channels, int x0, int y0, float (&block)[3][64]) {
+    for (int y = 0; y < 8; ++y) {
+      int sy = std::min(y0 + y, height - 1);
+      for (int x = 0; x < 8; ++x) {
+        int sx = std::min(x0 + x, width - 1);
+        const unsigned char* p = data + (static_cast<size_t>(sy) * width + sx) * channels;
+        if (channels >= 3) {
+          float r = p[0], g = p[1], b = p[2];
+          block[0][y * 8 + x] = 0.299f * r + 0.587f * g + 0.114f * b - 128.f;
+          block[1][y * 8 + x] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+          block[2][y * 8 + x] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+        } else {
+          block[0][y * 8 + x] = p[0] - 128.f;
+        }
+      }
+    }
+  }
+
+  // scaled 8-point DCT of the Arai, Agui and Nakajima algorithm, as in the IJG library, on elements stride apart
+  static void dct(float* d, int stride) {
+    float tmp0 = d[0] + d[7 * stride];
+    float tmp7 = d[0] - d[7 * stride];
+    float tmp1 = d[stride] + d[6 * stride];
+    float tmp6 = d[stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
+
+    // even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = 0.541196100f * tmp10 + z5;
+    float z4 = 1.306562965f * tmp12 + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+  }
+
+  // transform, quantise and entropy-code a block
+  void encode_block(BitWriter& writer, float* block, int table, int& dc) const {
+    // separable DCT: rows, then columns
+    for (int y = 0; y < 8; ++y) {
+      dct(block + y * 8, 1);
+    }
+    for (int x = 0; x < 8; ++x) {
+      dct(block + x, 8);
+    }
+    int coefficients[64];
+    for (int i = 0; i < 64; ++i) {
+      // baseline JPEG codes the AC coefficients with up to 10 bits, and the DC differences with up to 11 bits
+      float value = block[i] * scale_[table][i];
+      coefficients[i] = std::clamp(static_cast<int>(value + (value < 0.f ? -0.5f : 0.5f)), -1023, 1023);
+    }
+
+    Code const* dc_codes = codes_[table * 2];
+    Code const* ac_codes = codes_[table * 2 + 1];
+
+    // the DC coefficient is coded as the difference from the previous block of the same component
+    int diff = coefficients[0] - dc;
+    dc = coefficients[0];
+    int length = std::bit_width(static_cast<unsigned>(std::abs(diff)));
+    writer.put(dc_codes[length].code, dc_codes[length].length);
+    writer.put(diff < 0 ? diff - 1 : diff, length);
+
+    // the AC coefficients are coded as (run of zeros, size) symbols, followed by their value
+    int run = 0;
+    for (int i = 1; i < 64; ++i) {
+      int value = coefficients[zigzag[i]];
+      if (value == 0) {
+        ++run;
+        continue;
+      }
+      while (run >= 16) {
+        writer.put(ac_codes[0xf0].code, ac_codes[0xf0].length);
+        run -= 16;
+      }
+      int length = std::bit_width(static_cast<unsigned>(std::abs(value)));
+      int symbol = (run << 4) | length;
+      writer.put(ac_codes[symbol].code, ac_codes[symbol].length);
+      writer.put(value < 0 ? value - 1 : value, length);
+      run = 0;
+    }
+    if (run > 0) {
+      // end of block
+      writer.put(ac_codes[0x00].code, ac_codes[0x00].length);
+    }
+  }
+
+  void write_headers(std::vector<unsigned char>& out, int width, int height, int components, int interval) const {
+    // JFIF
+    out.insert(out.end(), {0xff, 0xe0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0});
+
+    // quantisation tables, in zig-zag order
+    int quant_tables = components == 3 ? 2 : 1;
+    out.insert(out.end(), {0xff, 0xdb});
+    put_be16(out, 2 + 65 * quant_tables);
+    for (int t = 0; t < quant_tables; ++t) {
+      out.push_back(t);
+      for (int i = 0; i < 64; ++i) {
+        out.push_back(quant_[t][zigzag[i]]);
+      }
+    }
+
+    // frame header: 8-bit baseline, no subsampling
+    out.insert(out.end(), {0xff, 0xc0});
+    put_be16(out, 8 + 3 * components);
+    out.push_back(8);
+    put_be16(out, height);
+    put_be16(out, width);
+    out.push_back(components);
+    for (int c = 0; c < components; ++c) {
+      out.insert(out.end(), {static_cast<unsigned char>(c + 1), 0x11, static_cast<unsigned char>(c == 0 ? 0 : 1)});
+    }
+
+    // Huffman tables
+    int huffman_tables = components == 3 ? 4 : 2;
+    for (int t = 0; t < huffman_tables; ++t) {
+      out.insert(out.end(), {0xff, 0xc4});
+      put_be16(out, 3 + 16 + tables[t].values.size());
+      out.push_back(((t % 2) << 4) | (t / 2));
+      out.insert(out.end(), tables[t].bits, tables[t].bits + 16);
+      out.insert(out.end(), tables[t].values.begin(), tables[t].values.end());
+    }
+
+    // restart interval, in blocks
+    out.insert(out.end(), {0xff, 0xdd, 0, 4});
+    put_be16(out, interval);
+
+    // scan header
+    out.insert(out.end(), {0xff, 0xda});
+    put_be16(out, 6 + 2 * components);
+    out.push_back(components);
+    for (int c = 0; c < components; ++c) {
+      out.insert(out.end(), {static_cast<unsigned char>(c + 1), static_cast<unsigned char>(c == 0 ? 0x00 : 0x11)});
+    }
+    out.insert(out.end(), {0, 63, 0});
+  }
+
+  int quant_[2][64];
+  float scale_[2][64];
+  Code codes_[4][256];
+};
+
+#endif  // encode_h
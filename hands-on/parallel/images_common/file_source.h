@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef file_source_h
+#define file_source_h
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// lazy source of input files: the files and the directories given on the command line, walked recursively, or a
+// newline-separated list of files read from the standard input for "-"; the next files are announced to the kernel
+// with posix_fadvise, so that they are read ahead while the current ones are decoded and processed
+class FileSource {
+public:
+  FileSource(std::vector<std::string> args, int prefetch) : args_(std::move(args)), prefetch_(prefetch) {}
+
+  // return the next input file, or false after the last one
+  bool next(std::string& filename) {
+    std::string ahead;
+    while (static_cast<int>(window_.size()) <= prefetch_ and fetch(ahead)) {
+      prefetch(ahead);
+      window_.push_back(std::move(ahead));
+    }
+    if (window_.empty()) {
+      return false;
+    }
+    filename = std::move(window_.front());
+    window_.pop_front();
+    return true;
+  }
+
+private:
+  // return the next file from the current directory, the standard input, or the command line
+  bool fetch(std::string& filename) {
+    while (true) {
+      if (walking_) {
+        // skip the files that cannot be decoded, and report the errors while walking the directories
+        std::error_code error;
+        for (; dir_ != std::filesystem::recursive_directory_iterator(); dir_.increment(error)) {
+          if (dir_->is_regular_file(error) and is_image(dir_->path())) {
+            filename = dir_->path().string();
+            dir_.increment(error);
+            return true;
+          }
+        }
+        if (error) {
+          std::cerr << "Error while reading a directory: " << error.message() << '\n';
+        }
+        walking_ = false;
+      }
+      if (reading_) {
+        while (std::getline(std::cin, filename)) {
+          if (not filename.empty()) {
+            return true;
+          }
+        }
+        reading_ = false;
+      }
+      if (arg_ == args_.size()) {
+        return false;
+      }
+      std::string const& arg = args_[arg_++];
+      if (arg == "-") {
+        reading_ = true;
+      } else if (std::filesystem::is_directory(arg)) {
+        dir_ = std::filesystem::recursive_directory_iterator(arg);
+        walking_ = true;
+      } else {
+        filename = arg;
+        return true;
+      }
+    }
+  }
+
+  // formats supported by stb_image
+  static bool is_image(std::filesystem::path const& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+      return std::tolower(c);
+    });
+    return extension == ".png" or extension == ".jpg" or extension == ".jpeg" or extension == ".bmp" or
+           extension == ".tga" or extension == ".gif" or extension == ".psd" or extension == ".pnm";
+  }
+
+  // ask the kernel to start reading the whole file in the page cache, without waiting for it
+  static void prefetch(std::string const& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      ::close(fd);
+    }
+  }
+
+  std::vector<std::string> args_;
+  size_t arg_ = 0;
+  int prefetch_;
+  std::deque<std::string> window_;
+  std::filesystem::recursive_directory_iterator dir_;
+  bool walking_ = false;
+  bool reading_ = false;
+};
+
+#endif  // file_source_h
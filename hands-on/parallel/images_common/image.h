@@ -0,0 +1,310 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef image_h
+#define image_h
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <syncstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include "sixel.h"
+
+#include "buffer_pool.h"
+#include "encode.h"
+#include "trace.h"
+
+// report the timing of the kernels and the images being loaded
+inline bool verbose = true;
+
+struct Image {
+  unsigned char* data_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  int channels_ = 0;
+  // the image data comes from the BufferPool, rather than from stb_image
+  bool pooled_ = false;
+  // size of the memory mapping of a DecodeCache entry that holds the image data after its header, or 0
+  size_t mapped_ = 0;
+  // content address of the image, used by the StageCache, or 0 if unknown
+  uint64_t hash_ = 0;
+
+  Image() {}
+
+  Image(std::string const& filename) { open(filename); }
+
+  Image(int width, int height, int channels) : width_(width), height_(height), channels_(channels) {
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
+    std::memset(data_, 0x00, size);
+  }
+
+  ~Image() { close(); }
+
+  // copy constructor
+  Image(Image const& img)
+      : width_(img.width_), height_(img.height_), channels_(img.channels_), hash_(img.hash_) {
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
+    std::memcpy(data_, img.data_, size);
+  }
+
+  // copy assignment
+  Image& operator=(Image const& img) {
+    // avoid self-copies
+    if (&img == this) {
+      return *this;
+    }
+
+    // free any existing image data
+    close();
+
+    width_ = img.width_;
+    height_ = img.height_;
+    channels_ = img.channels_;
+    hash_ = img.hash_;
+    size_t size = static_cast<size_t>(width_) * height_ * channels_;
+    data_ = BufferPool::instance().acquire(size);
+    pooled_ = true;
+    std::memcpy(data_, img.data_, size);
+
+    return *this;
+  }
+
+  // move constructor
+  Image(Image&& img)
+      : data_(img.data_),
+        width_(img.width_),
+        height_(img.height_),
+        channels_(img.channels_),
+        pooled_(img.pooled_),
+        mapped_(img.mapped_),
+        hash_(img.hash_) {
+    // take owndership of the image data
+    img.data_ = nullptr;
+  }
+
+  // move assignment
+  Image& operator=(Image&& img) {
+    // avoid self-moves
+    if (&img == this) {
+      return *this;
+    }
+
+    // free any existing image data
+    close();
+
+    // copy the image properties
+    width_ = img.width_;
+    height_ = img.height_;
+    channels_ = img.channels_;
+    pooled_ = img.pooled_;
+    mapped_ = img.mapped_;
+    hash_ = img.hash_;
+
+    // take owndership of the image data
+    data_ = img.data_;
+    img.data_ = nullptr;
+
+    return *this;
+  }
+
+  void open(std::string const& filename) {
+    // read the whole file with a single request, then decode it from memory
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> buffer;
+    if (file) {
+      buffer.resize(std::filesystem::file_size(filename));
+      file.read(buffer.data(), buffer.size());
+    }
+    if (not file) {
+      throw std::runtime_error("Failed to read " + filename);
+    }
+
+    decode(buffer.data(), buffer.size(), filename);
+  }
+
+  // map the file in memory and decode it directly from the page cache, without copying it to a buffer first
+  void open_mmap(std::string const& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 or info.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to read " + filename);
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Failed to map " + filename);
+    }
+
+    // the decoders read the file from start to end
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    try {
+      decode(mapping, info.st_size, filename);
+    } catch (...) {
+      munmap(mapping, info.st_size);
+      throw;
+    }
+    munmap(mapping, info.st_size);
+  }
+
+  // let stb_image read the file through stdio
+  void open_stdio(std::string const& filename) {
+    data_ = stbi_load(filename.c_str(), &width_, &height_, &channels_, 0);
+    if (data_ == nullptr) {
+      throw std::runtime_error("Failed to load " + filename);
+    }
+    loaded(filename);
+  }
+
+  // write the image with the parallel encoders, and report their throughput
+  void write(std::string const& filename) {
+    TraceScope trace("encode");
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<unsigned char> buffer;
+    if (filename.ends_with(".png")) {
+      buffer = encode_png(data_, width_, height_, channels_);
+    } else if (filename.ends_with(".jpg") or filename.ends_with(".jpeg")) {
+      buffer = JpegEncoder(95).encode(data_, width_, height_, channels_);
+    } else {
+      throw std::runtime_error("File format " + filename + "not supported");
+    }
+
+    auto finish = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+    if (verbose) {
+      size_t size = static_cast<size_t>(width_) * height_ * channels_;
+      std::cerr << std::format("encode:     {:6.2f} ms, {:8.2f} MB/s", ms, size / ms / 1.e3) << '\n';
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (not file) {
+      throw std::runtime_error("Error while writing file " + filename);
+    }
+  }
+
+  // write the image with the single-threaded stb_image_write encoders
+  void write_stb(std::string const& filename) {
+    if (filename.ends_with(".png")) {
+      int status = stbi_write_png(filename.c_str(), width_, height_, channels_, data_, 0);
+      if (status == 0) {
+        throw std::runtime_error("Error while writing PNG file " + filename);
+      }
+    } else if (filename.ends_with(".jpg") or filename.ends_with(".jpeg")) {
+      int status = stbi_write_jpg(filename.c_str(), width_, height_, channels_, data_, 95);
+      if (status == 0) {
+        throw std::runtime_error("Error while writing JPEG file " + filename);
+      }
+    } else {
+      throw std::runtime_error("File format " + filename + "not supported");
+    }
+  }
+
+  void close() {
+    if (data_ != nullptr) {
+      size_t size = static_cast<size_t>(width_) * height_ * channels_;
+      if (mapped_ != 0) {
+        // unmap the whole cache entry, including its header
+        munmap(data_ + size - mapped_, mapped_);
+      } else if (pooled_) {
+        // return the buffer to the pool, for the next image of a similar size
+        BufferPool::instance().release(data_, size);
+      } else {
+        stbi_image_free(data_);
+      }
+    }
+    data_ = nullptr;
+    pooled_ = false;
+    mapped_ = 0;
+  }
+
+  // decode an image from the content of a file
+  void decode(const void* buffer, size_t size, std::string const& filename) {
+    TraceScope trace("decode");
+    data_ = stbi_load_from_memory(static_cast<const stbi_uc*>(buffer), size, &width_, &height_, &channels_, 0);
+    if (data_ == nullptr) {
+      throw std::runtime_error("Failed to load " + filename);
+    }
+    loaded(filename);
+  }
+
+  void loaded(std::string const& filename) const {
+    if (verbose) {
+      std::osyncstream out(std::cout);
+      out << "Loaded image with " << width_ << " x " << height_ << " pixels and " << channels_ << " channels from "
+          << filename << '\n';
+    }
+  }
+
+  static int sixel_write(char* data, int size, void* priv) {
+    // callback for output sixel
+    return fwrite(data, 1, size, (FILE*)priv);
+  }
+
+  // show an image on the terminal
+  void show() {
+    if (data_ == nullptr) {
+      return;
+    }
+
+    sixel_output_t* output = nullptr;
+    auto status = sixel_output_new(&output, sixel_write, stdout, nullptr);
+    if (SIXEL_FAILED(status))
+      exit(EXIT_FAILURE);
+
+    sixel_dither_t* dither = sixel_dither_get(SIXEL_BUILTIN_XTERM256);
+    if (channels_ == 1) {
+      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_G8);
+    } else if (channels_ == 3) {
+      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_RGB888);
+    } else if (channels_ == 4) {
+      sixel_dither_set_pixelformat(dither, SIXEL_PIXELFORMAT_RGBA8888);
+    }
+
+    status = sixel_encode(data_, width_, height_, 0, dither, output);
+    if (SIXEL_FAILED(status))
+      exit(EXIT_FAILURE);
+  }
+};
+
+#endif  // image_h
@@ -0,0 +1,223 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef memo_h
+#define memo_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// mix a 64-bit word into a hash; this is not a cryptographic hash, but it costs only a multiplication and a shift per
+// word, so hashing an image runs close to the memory bandwidth
+constexpr uint64_t hash_mix(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * 0x9e3779b97f4a7c15ull;
+  return hash ^ (hash >> 32);
+}
+
+constexpr uint64_t hash_seed = 0x243f6a8885a308d3ull;
+
+// content address of an image, from its size and its pixels; the chunks are hashed in parallel and combined in order
+template <typename Image>
+uint64_t content_hash(Image const& img) {
+  constexpr size_t chunk = 1 << 20;
+  size_t size = static_cast<size_t>(img.width_) * img.height_ * img.channels_;
+  std::vector<uint64_t> hashes((size + chunk - 1) / chunk);
+  tbb::parallel_for(size_t{0}, hashes.size(), [&](size_t i) {
+    const unsigned char* data = img.data_ + i * chunk;
+    size_t bytes = std::min(chunk, size - i * chunk);
+    uint64_t hash = hash_mix(hash_seed, i);
+    size_t j = 0;
+    for (; j + sizeof(uint64_t) <= bytes; j += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, data + j, sizeof(uint64_t));
+      hash = hash_mix(hash, word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + j, bytes - j);
+    hashes[i] = hash_mix(hash, tail);
+  });
+
+  uint64_t hash = hash_mix(hash_mix(hash_mix(hash_seed, img.width_), img.height_), img.channels_);
+  for (uint64_t chunk_hash : hashes) {
+    hash = hash_mix(hash, chunk_hash);
+  }
+  // 0 means unknown
+  return hash == 0 ? 1 : hash;
+}
+
+// mix the content addresses of the inputs of a stage into its address, or return 0 if any of them is unknown
+template <typename Image>
+uint64_t mix_inputs(uint64_t hash, std::shared_ptr<Image> const& img) {
+  return (hash == 0 or img->hash_ == 0) ? 0 : hash_mix(hash, img->hash_);
+}
+
+template <typename... Images>
+uint64_t mix_inputs(uint64_t hash, std::tuple<Images...> const& images) {
+  std::apply([&hash](auto const&... img) { ((hash = mix_inputs(hash, img)), ...); }, images);
+  return hash;
+}
+
+// persistent store of the results of the flow graph stages, by content address, shared with the next runs
+template <typename Image>
+class ResultStore {
+public:
+  virtual ~ResultStore() = default;
+
+  // read the result stored for address into img and return true, or return false if there is none
+  virtual bool load(uint64_t address, Image& img) = 0;
+
+  // store the result of a stage for address, replacing any previous one
+  virtual void store(uint64_t address, Image const& img) = 0;
+};
+
+// in-memory cache of the results of the flow graph stages, by content address: running a stage again with the same
+// parameters on an input with the same content reuses its previous result; the least recently used results are
+// evicted beyond the capacity, and all results are also written to the ResultStore on disk, if any, for the next runs
+template <typename Image>
+class StageCache {
+public:
+  struct Stats {
+    size_t hits;
+    size_t disk_hits;
+    size_t misses;
+  };
+
+  StageCache(size_t capacity, ResultStore<Image>* disk) : capacity_(capacity), disk_(disk) {}
+
+  // content address of a stage with the given parameters, before mixing in those of its inputs
+  static uint64_t address(const char* stage, std::vector<int> const& parameters) {
+    uint64_t hash = hash_seed;
+    for (const char* c = stage; *c != '\0'; ++c) {
+      hash = hash_mix(hash, static_cast<unsigned char>(*c));
+    }
+    for (int parameter : parameters) {
+      hash = hash_mix(hash, static_cast<uint32_t>(parameter));
+    }
+    return hash;
+  }
+
+  // return the result cached for address, or nullptr if there is none; the cached results are shared rather than
+  // copied, as the next stages modify an image in place only if they hold the only reference to it, and copy it
+  // otherwise
+  std::shared_ptr<Image> find(uint64_t address) {
+    std::shared_ptr<Image> result;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = entries_.find(address);
+      if (it != entries_.end()) {
+        lru_.splice(lru_.end(), lru_, it->second.position);
+        result = it->second.image;
+      }
+    }
+    if (result) {
+      ++hits_;
+    } else if (auto img = std::make_shared<Image>(); disk_ != nullptr and disk_->load(address, *img)) {
+      img->hash_ = address;
+      std::lock_guard<std::mutex> lock(mutex_);
+      put(address, img);
+      result = std::move(img);
+      ++disk_hits_;
+    } else {
+      ++misses_;
+    }
+    return result;
+  }
+
+  // cache the result of a stage, and set its content address
+  void insert(uint64_t address, std::shared_ptr<Image> const& result) {
+    result->hash_ = address;
+    if (disk_ != nullptr) {
+      disk_->store(address, *result);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    put(address, result);
+  }
+
+  Stats stats() const { return Stats{hits_.load(), disk_hits_.load(), misses_.load()}; }
+
+private:
+  struct Entry {
+    std::list<uint64_t>::iterator position;
+    std::shared_ptr<Image> image;
+    size_t size;
+  };
+
+  // add or replace an entry, then evict the least recently used ones until the cache fits in its capacity
+  void put(uint64_t address, std::shared_ptr<Image> image) {
+    size_t size = static_cast<size_t>(image->width_) * image->height_ * image->channels_;
+    auto it = entries_.find(address);
+    if (it != entries_.end()) {
+      lru_.splice(lru_.end(), lru_, it->second.position);
+      total_ -= it->second.size;
+      it->second.image = std::move(image);
+      it->second.size = size;
+    } else {
+      entries_.emplace(address, Entry{lru_.insert(lru_.end(), address), std::move(image), size});
+    }
+    total_ += size;
+
+    while (total_ > capacity_ and not lru_.empty()) {
+      auto victim = entries_.find(lru_.front());
+      total_ -= victim->second.size;
+      entries_.erase(victim);
+      lru_.pop_front();
+    }
+  }
+
+  size_t capacity_;
+  ResultStore<Image>* disk_;
+  size_t total_ = 0;
+  std::mutex mutex_;
+  std::list<uint64_t> lru_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  std::atomic<size_t> hits_ = 0;
+  std::atomic<size_t> disk_hits_ = 0;
+  std::atomic<size_t> misses_ = 0;
+};
+
+// memoize the results of a flow graph node in a StageCache: the node runs only if the content of its inputs, together
+// with the name of the stage and its parameters, has not been seen before; without a cache, or for inputs without a
+// content address, the node always runs
+template <typename Image, typename Body>
+auto memoized(StageCache<Image>* cache, const char* stage, std::vector<int> parameters, Body body) {
+  uint64_t address = StageCache<Image>::address(stage, parameters);
+  return [cache, address, body](auto const& input) -> std::shared_ptr<Image> {
+    uint64_t input_address = cache == nullptr ? 0 : mix_inputs(address, input);
+    if (input_address == 0) {
+      return body(input);
+    }
+    if (auto result = cache->find(input_address)) {
+      return result;
+    }
+    auto result = body(input);
+    cache->insert(input_address, result);
+    return result;
+  };
+}
+
+#endif  // memo_h
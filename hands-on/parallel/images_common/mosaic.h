@@ -0,0 +1,169 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef mosaic_h
+#define mosaic_h
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "channels.h"
+#include "resample.h"
+#include "simd.h"
+
+// an RGB colour, used to parametrise the tints
+struct Color {
+  int r;
+  int g;
+  int b;
+};
+
+// tints applied by the pipeline: purple-ish, green-ish and gold-ish
+constexpr std::array<Color, 3> tints = {{{168, 56, 172}, {100, 143, 47}, {255, 162, 36}}};
+
+// compute the rows of the mosaic of an RGB or RGBA image, with the same channels as the source; the grayscale and
+// tinted rows are computed with the SIMD kernels, directly in the output image
+template <int Channels, typename Loop>
+void mosaic_rows(Resampler const& resampler,
+                 const unsigned char* src,
+                 int src_width,
+                 unsigned char* out,
+                 int width,
+                 int height,
+                 std::array<Color, 3> const& colors,
+                 Loop const& loop) {
+  auto const& kernels = simd_kernels();
+  const size_t row_size = static_cast<size_t>(width) * Channels;
+  // the output image has twice the width of each quadrant
+  auto pixel = [&](int x, int y) { return out + (static_cast<size_t>(y) * width * 2 + x) * Channels; };
+
+  loop("mosaic", height, width, [&](int begin, int end) {
+    std::vector<int32_t> acc(static_cast<size_t>(src_width) * Channels);
+    std::vector<unsigned char> buffer(static_cast<size_t>(src_width) * Channels);
+    for (int y = begin; y < end; ++y) {
+      // scale and convert the row to grayscale directly in the bottom-right quadrant
+      unsigned char* gray = pixel(width, height + y);
+      resampler.resample_row<Channels>(src, y, gray, acc.data(), buffer.data());
+      int done = kernels.grayscale(gray, width, Channels);
+      grayscale_scalar<Channels>(gray + done * Channels, width - done);
+
+      // copy and tint the grayscale row in the other three quadrants
+      unsigned char* rows[3] = {pixel(0, y), pixel(width, y), pixel(0, height + y)};
+      for (int i = 0; i < 3; ++i) {
+        auto [r, g, b] = colors[i];
+        std::memcpy(rows[i], gray, row_size);
+        int done = kernels.tint(rows[i], width, Channels, r, g, b);
+        tint_scalar<Channels>(rows[i] + done * Channels, width - done, r, g, b);
+      }
+    }
+  });
+}
+
+// compute the rows of the mosaic of an image into an RGB or RGBA image with OutChannels channels: the gray value is
+// computed from the colour channels, or taken from the first channel of the images without colour channels, and an
+// RGBA output keeps the alpha channel of a 2-channel source; used for the grayscale images, and for the single-channel
+// grayscale copies of the colour images
+template <int Channels, int OutChannels, typename Loop>
+void mosaic_rows_gray(Resampler const& resampler,
+                 const unsigned char* src,
+                 int src_width,
+                 unsigned char* out,
+                 int width,
+                 int height,
+                 std::array<Color, 3> const& colors,
+                 Loop const& loop) {
+  // the output image has twice the width of each quadrant
+  auto pixel = [&](int x, int y) { return out + (static_cast<size_t>(y) * width * 2 + x) * OutChannels; };
+
+  loop("mosaic", height, width, [&](int begin, int end) {
+    std::vector<int32_t> acc(static_cast<size_t>(src_width) * Channels);
+    std::vector<unsigned char> buffer(static_cast<size_t>(src_width) * Channels);
+    std::vector<unsigned char> line(static_cast<size_t>(width) * Channels);
+    for (int y = begin; y < end; ++y) {
+      resampler.resample_row<Channels>(src, y, line.data(), acc.data(), buffer.data());
+      unsigned char* rows[4] = {pixel(0, y), pixel(width, y), pixel(0, height + y), pixel(width, height + y)};
+      for (int x = 0; x < width; ++x) {
+        const unsigned char* in = line.data() + x * Channels;
+        uint32_t value = in[0];
+        if constexpr (Channels >= 3) {
+          // NTSC values for RGB to grayscale conversion, with the same exact division as the SIMD kernels
+          uint32_t sum = 299 * in[0] + 587 * in[1] + 114 * in[2];
+          value = ((sum >> 3) * 33555) >> 22;
+        }
+        for (int i = 0; i < 3; ++i) {
+          // same exact division by 255 as the SIMD kernels
+          unsigned char* p = rows[i] + x * OutChannels;
+          p[0] = (value * colors[i].r * 0x8081) >> 23;
+          p[1] = (value * colors[i].g * 0x8081) >> 23;
+          p[2] = (value * colors[i].b * 0x8081) >> 23;
+        }
+        unsigned char* p = rows[3] + x * OutChannels;
+        p[0] = value;
+        p[1] = value;
+        p[2] = value;
+        if constexpr (OutChannels == 4) {
+          for (int i = 0; i < 4; ++i) {
+            rows[i][x * OutChannels + 3] = in[1];
+          }
+        }
+      }
+    }
+  });
+}
+
+// fused "scale, grayscale, tint and mosaic" operator: produce the same image as the staged pipeline, with the three
+// tinted copies in the top-left, top-right and bottom-left quadrants and the grayscale copy in the bottom-right one;
+// each row of the four quadrants is computed from the source rows while they are still in cache, without allocating
+// or traversing any intermediate image; the rows are split among the tasks by the loop policy
+//
+// like the staged pipeline, the images without colour channels are tinted into RGB or RGBA images, and with
+// single_channel the grayscale copy is computed as a single channel, so the tinted copies are RGB images
+template <typename Image, typename Loop = SequentialRows>
+Image mosaic(Image const& src,
+             int width,
+             int height,
+             Filter filter,
+             std::array<Color, 3> const& colors,
+             bool single_channel = false,
+             Loop const& loop = {}) {
+  int out_channels = single_channel ? 3 : (src.channels_ >= 3 ? src.channels_ : src.channels_ + 2);
+  Image out(width * 2, height * 2, out_channels);
+  auto resampler = Resampler::get(src.width_, src.height_, width, height, filter);
+
+  with_channels<1, 2, 3, 4>(src.channels_, [&](auto channels) {
+    if constexpr (channels >= 3) {
+      if (not single_channel) {
+        mosaic_rows<channels>(*resampler, src.data_, src.width_, out.data_, width, height, colors, loop);
+        return;
+      }
+    }
+    with_channels<3, 4>(out_channels, [&](auto out_channels) {
+      // only the 2-channel images have an alpha channel in the RGBA output
+      if constexpr (out_channels == 3 or channels == 2) {
+        mosaic_rows_gray<channels, out_channels>(
+            *resampler, src.data_, src.width_, out.data_, width, height, colors, loop);
+      }
+    });
+  });
+
+  return out;
+}
+
+#endif  // mosaic_h
@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef preview_h
+#define preview_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <tbb/tbb.h>
+
+#include "image.h"
+#include "resample.h"
+
+// terminal preview on a dedicated thread, so that a slow terminal never stalls the flow graph: the images are queued
+// without blocking, and dropped when the queue is full; the preview thread shows at most fps images per second, scaled
+// down to the size of the terminal before they are encoded
+class Preview {
+public:
+  Preview(double fps, int capacity = 2)
+      : interval_(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1. / fps))) {
+    queue_.set_capacity(capacity);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~Preview() { stop(); }
+
+  // queue an image for the preview, or drop it if the preview is falling behind
+  void push(std::shared_ptr<Image> const& img) {
+    if (not queue_.try_push(img)) {
+      ++dropped_;
+    }
+  }
+
+  // show the images already in the queue, and wait for the preview thread to finish
+  void stop() {
+    if (thread_.joinable()) {
+      queue_.push(nullptr);
+      thread_.join();
+    }
+  }
+
+  int shown() const { return shown_; }
+  int dropped() const { return dropped_; }
+
+private:
+  void run() {
+    // scale the images on this thread only, without taking any worker thread from the flow graph
+    tbb::task_arena arena(1);
+    auto next = std::chrono::steady_clock::now();
+    std::shared_ptr<Image> img;
+    while (true) {
+      queue_.pop(img);
+      if (not img) {
+        break;
+      }
+      // while waiting for the next slot, the queue fills up and the new images are dropped
+      std::this_thread::sleep_until(next);
+      arena.execute([&] { thumbnail(*img).show(); });
+      ++shown_;
+      next = std::chrono::steady_clock::now() + interval_;
+    }
+  }
+
+  // scale the image down to fit the terminal, keeping its aspect ratio
+  static Image thumbnail(Image const& img) {
+    int width = 800;
+    int height = 600;
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+      if (size.ws_xpixel != 0 and size.ws_ypixel != 0) {
+        width = size.ws_xpixel;
+        height = size.ws_ypixel;
+      } else if (size.ws_col != 0 and size.ws_row != 0) {
+        // assume 10 x 20 pixels per character
+        width = size.ws_col * 10;
+        height = size.ws_row * 20;
+      }
+    }
+
+    double ratio = std::min({1., static_cast<double>(width) / img.width_, static_cast<double>(height) / img.height_});
+    if (ratio == 1.) {
+      return img;
+    }
+    width = std::max<int>(img.width_ * ratio, 1);
+    height = std::max<int>(img.height_ * ratio, 1);
+    return Resampler::get(img.width_, img.height_, width, height, Filter::Box)->apply(img);
+  }
+
+  std::chrono::steady_clock::duration interval_;
+  tbb::concurrent_bounded_queue<std::shared_ptr<Image>> queue_;
+  std::thread thread_;
+  std::atomic<int> shown_ = 0;
+  std::atomic<int> dropped_ = 0;
+};
+
+#endif  // preview_h
@@ -0,0 +1,345 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef resample_h
+#define resample_h
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "channels.h"
+
+// resampling filters supported by the separable scaling engine
+enum class Filter { Bilinear, Box, Lanczos3 };
+
+// number of fractional bits in the fixed-point resampling weights
+constexpr int weight_bits = 14;
+
+// precomputed source indices and fixed-point weights along one axis of a resampling operation:
+// output sample i is the weighted sum of the taps_ source samples index_[i * taps_ + k],
+// with weights weight_[i * taps_ + k]
+struct ResampleAxis {
+  int taps_ = 0;
+  std::vector<int> index_;
+  std::vector<int32_t> weight_;
+
+  ResampleAxis(int src_size, int dst_size, Filter filter) {
+    double ratio = static_cast<double>(src_size) / dst_size;
+
+    // compute the floating point contributions of the source samples to each output sample
+    std::vector<std::vector<std::pair<int, double>>> contributions(dst_size);
+    for (int i = 0; i < dst_size; ++i) {
+      auto& contrib = contributions[i];
+      switch (filter) {
+        case Filter::Bilinear: {
+          // same mapping as the reference kernel: interpolate between the nearest two source samples
+          double pos = i * ratio;
+          int i0 = std::clamp(static_cast<int>(std::floor(pos)), 0, src_size - 1);
+          int i1 = std::min(i0 + 1, src_size - 1);
+          double w1 = pos - i0;
+          contrib.emplace_back(i0, 1. - w1);
+          contrib.emplace_back(i1, w1);
+          break;
+        }
+        case Filter::Box: {
+          // average the source samples covered by the output sample, weighted by their overlap
+          double from = i * ratio;
+          double to = (i + 1) * ratio;
+          for (int j = static_cast<int>(std::floor(from)); j < std::ceil(to); ++j) {
+            double overlap = std::min<double>(to, j + 1) - std::max<double>(from, j);
+            if (overlap > 0.) {
+              contrib.emplace_back(std::clamp(j, 0, src_size - 1), overlap);
+            }
+          }
+          break;
+        }
+        case Filter::Lanczos3: {
+          // widen the filter when downscaling, to avoid aliasing
+          double scale = std::max(ratio, 1.);
+          double support = 3. * scale;
+          double center = (i + 0.5) * ratio;
+          for (int j = static_cast<int>(std::floor(center - support)); j < std::ceil(center + support); ++j) {
+            double x = (j + 0.5 - center) / scale;
+            double w = lanczos3(x);
+            if (w != 0.) {
+              contrib.emplace_back(std::clamp(j, 0, src_size - 1), w);
+            }
+          }
+          break;
+        }
+      }
+    }
+
+    // convert the weights to fixed point, making sure that they add up exactly to one, and drop the null ones
+    std::vector<std::vector<std::pair<int, int32_t>>> fixed(dst_size);
+    for (int i = 0; i < dst_size; ++i) {
+      auto const& contrib = contributions[i];
+      double sum = 0.;
+      for (auto const& [j, w] : contrib) {
+        sum += w;
+      }
+      int32_t total = 0;
+      int largest = 0;
+      for (auto const& [j, w] : contrib) {
+        fixed[i].emplace_back(j, std::lround(w / sum * (1 << weight_bits)));
+        total += fixed[i].back().second;
+        if (fixed[i].back().second > fixed[i][largest].second) {
+          largest = fixed[i].size() - 1;
+        }
+      }
+      fixed[i][largest].second += (1 << weight_bits) - total;
+      std::erase_if(fixed[i], [](auto const& tap) { return tap.second == 0; });
+      taps_ = std::max<int>(taps_, fixed[i].size());
+    }
+
+    // store the taps with a fixed stride, padding the unused ones with null weights
+    index_.resize(dst_size * taps_);
+    weight_.resize(dst_size * taps_);
+    for (int i = 0; i < dst_size; ++i) {
+      for (int k = 0; k < taps_; ++k) {
+        bool used = k < static_cast<int>(fixed[i].size());
+        index_[i * taps_ + k] = used ? fixed[i][k].first : fixed[i].front().first;
+        weight_[i * taps_ + k] = used ? fixed[i][k].second : 0;
+      }
+    }
+  }
+
+  // range of source samples [first, last) that contribute to the output samples [from, to)
+  std::pair<int, int> span(int from, int to) const {
+    auto [first, last] = std::minmax_element(index_.begin() + from * taps_, index_.begin() + to * taps_);
+    return {*first, *last + 1};
+  }
+
+  static double lanczos3(double x) {
+    if (x == 0.) {
+      return 1.;
+    }
+    if (std::abs(x) >= 3.) {
+      return 0.;
+    }
+    double px = std::numbers::pi * x;
+    return 3. * std::sin(px) * std::sin(px / 3.) / (px * px);
+  }
+};
+
+// loop policy of the image-level operations: run body(begin, end) over the rows [0, rows) of an image with cols pixels
+// per row, where kernel names the loop for the policies that tune it; this one runs the whole loop sequentially
+struct SequentialRows {
+  template <typename Body>
+  void operator()(const char* kernel, int rows, int cols, Body const& body) const {
+    body(0, rows);
+  }
+};
+
+// separable image resampler: the source indices and weights are precomputed once per (source size, target size,
+// filter), then each image is scaled with a vertical and a horizontal pass; the passes over whole images run their
+// loops through a loop policy, while the row-level ones let each image type drive them
+class Resampler {
+public:
+  Resampler(int src_width, int src_height, int width, int height, Filter filter)
+      : src_width_(src_width),
+        src_height_(src_height),
+        width_(width),
+        height_(height),
+        horizontal_(src_width, width, filter),
+        vertical_(src_height, height, filter) {}
+
+  // number of resamplers kept by get(); a stream of images of many different sizes would otherwise grow the cache
+  // without bounds
+  static constexpr size_t cache_capacity = 16;
+
+  // return a shared resampler for the given sizes and filter, creating it on first use; the least recently used
+  // resamplers are evicted beyond cache_capacity, and live on while the callers hold them
+  static std::shared_ptr<const Resampler> get(int src_width, int src_height, int width, int height, Filter filter) {
+    using Key = std::tuple<int, int, int, int, Filter>;
+    struct Entry {
+      std::list<Key>::iterator position;
+      std::shared_ptr<const Resampler> resampler;
+    };
+    static std::mutex mutex;
+    static std::list<Key> lru;
+    static std::map<Key, Entry> cache;
+
+    Key key{src_width, src_height, width, height, filter};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+      lru.splice(lru.end(), lru, it->second.position);
+      return it->second.resampler;
+    }
+
+    auto resampler = std::make_shared<const Resampler>(src_width, src_height, width, height, filter);
+    cache.emplace(key, Entry{lru.insert(lru.end(), key), resampler});
+    if (cache.size() > cache_capacity) {
+      cache.erase(lru.front());
+      lru.pop_front();
+    }
+    return resampler;
+  }
+
+  // scale an interleaved image, of any type with the data_, width_, height_ and channels_ members
+  template <typename Image, typename Loop = SequentialRows>
+  Image apply(Image const& src, Loop const& loop = {}) const {
+    assert(src.width_ == src_width_ and src.height_ == src_height_);
+    assert(src.channels_ <= 4);
+
+    if (width_ == src_width_ and height_ == src_height_) {
+      return src;
+    }
+    if (height_ == src_height_) {
+      return horizontal_pass(src, loop);
+    }
+    if (width_ == src_width_) {
+      return vertical_pass(src, loop);
+    }
+
+    // the horizontal pass gathers pixels at scattered offsets and is the more expensive one: when the image
+    // is scaled down vertically run it after the vertical pass, on the smaller number of rows
+    if (vertical_first()) {
+      return horizontal_pass(vertical_pass(src, loop), loop);
+    } else {
+      return vertical_pass(horizontal_pass(src, loop), loop);
+    }
+  }
+
+  // whether the images scaled along both axes run the vertical pass first
+  bool vertical_first() const { return height_ < src_height_; }
+
+  // compute a single row of the scaled image from an interleaved image, for operators that consume the image one row
+  // at a time; acc must hold src_width_ * Channels elements, and buffer src_width_ * Channels bytes
+  template <int Channels>
+  void resample_row(const unsigned char* src, int y, unsigned char* line, int32_t* acc, unsigned char* buffer) const {
+    const int row_size = src_width_ * Channels;
+    vertical_row(src, row_size, row_size, y, acc, buffer);
+    horizontal_row<Channels>(buffer, line);
+  }
+
+  // resample a single row; the number of channels is known at compile time, so the inner loops can be fully unrolled;
+  // the tiled images compute only the output pixels [from, to), from a source row that starts at pixel first
+  template <int Channels>
+  void horizontal_row(const unsigned char* in, unsigned char* out, int from = 0, int to = -1, int first = 0) const {
+    // use local copies of the axis data: the stores through unsigned char pointers could alias them
+    const int taps = horizontal_.taps_;
+    const int* indices = horizontal_.index_.data();
+    const int32_t* weights = horizontal_.weight_.data();
+    const int width = to < 0 ? width_ : to;
+
+    for (int x = from; x < width; ++x) {
+      const int* index = indices + x * taps;
+      const int32_t* weight = weights + x * taps;
+      int32_t acc[Channels];
+      for (int c = 0; c < Channels; ++c) {
+        acc[c] = 1 << (weight_bits - 1);
+      }
+      for (int k = 0; k < taps; ++k) {
+        const unsigned char* p = in + (index[k] - first) * Channels;
+        int32_t w = weight[k];
+        for (int c = 0; c < Channels; ++c) {
+          acc[c] += w * p[c];
+        }
+      }
+      for (int c = 0; c < Channels; ++c) {
+        out[(x - from) * Channels + c] = std::clamp(acc[c] >> weight_bits, 0, 255);
+      }
+    }
+  }
+
+  // compute row y of the vertical pass, accumulating whole rows so the inner loops run over contiguous memory;
+  // the source rows are row_size bytes long, start stride bytes apart, and data points to row first_row
+  void vertical_row(const unsigned char* data,
+                    int stride,
+                    int row_size,
+                    int y,
+                    int32_t* acc,
+                    unsigned char* line,
+                    int first_row = 0) const {
+    const int taps = vertical_.taps_;
+    const int* index = vertical_.index_.data() + y * taps;
+    const int32_t* weight = vertical_.weight_.data() + y * taps;
+
+    std::fill(acc, acc + row_size, 1 << (weight_bits - 1));
+    for (int k = 0; k < taps; ++k) {
+      const unsigned char* in = data + static_cast<size_t>(index[k] - first_row) * stride;
+      int32_t w = weight[k];
+      for (int i = 0; i < row_size; ++i) {
+        acc[i] += w * in[i];
+      }
+    }
+    for (int i = 0; i < row_size; ++i) {
+      line[i] = std::clamp(acc[i] >> weight_bits, 0, 255);
+    }
+  }
+
+  // range of source columns and rows [first, last) that contribute to the output columns and rows [from, to)
+  std::pair<int, int> horizontal_span(int from, int to) const { return horizontal_.span(from, to); }
+  std::pair<int, int> vertical_span(int from, int to) const { return vertical_.span(from, to); }
+
+private:
+  // resample each row, from src_width_ to width_ pixels
+  template <typename Image, typename Loop>
+  Image horizontal_pass(Image const& src, Loop const& loop) const {
+    int channels = src.channels_;
+    Image out(width_, src.height_, channels);
+
+    with_channels<1, 2, 3, 4>(channels, [&](auto channels) {
+      loop("scale_horizontal", src.height_, width_, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+          horizontal_row<channels>(src.data_ + static_cast<size_t>(y) * src_width_ * channels,
+                                   out.data_ + static_cast<size_t>(y) * width_ * channels);
+        }
+      });
+    });
+
+    return out;
+  }
+
+  // resample each column, from src_height_ to height_ pixels
+  template <typename Image, typename Loop>
+  Image vertical_pass(Image const& src, Loop const& loop) const {
+    Image out(src.width_, height_, src.channels_);
+    const int row_size = src.width_ * src.channels_;
+
+    loop("scale_vertical", height_, src.width_, [&](int begin, int end) {
+      std::vector<int32_t> acc(row_size);
+      for (int y = begin; y < end; ++y) {
+        vertical_row(src.data_, row_size, row_size, y, acc.data(), out.data_ + static_cast<size_t>(y) * row_size);
+      }
+    });
+
+    return out;
+  }
+
+  int src_width_;
+  int src_height_;
+  int width_;
+  int height_;
+  ResampleAxis horizontal_;
+  ResampleAxis vertical_;
+};
+
+#endif  // resample_h
@@ -0,0 +1,396 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef simd_h
+#define simd_h
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "channels.h"
+
+// scalar kernels, used for the pixels not handled by the SIMD kernels and as the reference for their results;
+// like the SIMD ones, they process a run of pixels in place and return the number of pixels they handled
+template <int Channels>
+int grayscale_scalar(unsigned char* data, int pixels) {
+  for (int x = 0; x < pixels; ++x) {
+    int p = x * Channels;
+    int r = data[p];
+    int g = data[p + 1];
+    int b = data[p + 2];
+    // NTSC values for RGB to grayscale conversion
+    int y = (299 * r + 587 * g + 114 * b) / 1000;
+    data[p] = y;
+    data[p + 1] = y;
+    data[p + 2] = y;
+  }
+  return pixels;
+}
+
+template <int Channels>
+int tint_scalar(unsigned char* data, int pixels, int r, int g, int b) {
+  for (int x = 0; x < pixels; ++x) {
+    int p = x * Channels;
+    int r0 = data[p];
+    int g0 = data[p + 1];
+    int b0 = data[p + 2];
+    data[p] = r0 * r / 255;
+    data[p + 1] = g0 * g / 255;
+    data[p + 2] = b0 * b / 255;
+  }
+  return pixels;
+}
+
+// versions of the scalar kernels with the number of channels known only at runtime, for the table of kernels
+inline int grayscale_scalar(unsigned char* data, int pixels, int channels) {
+  with_channels<3, 4>(channels, [&](auto channels) { grayscale_scalar<channels>(data, pixels); });
+  return pixels;
+}
+
+inline int tint_scalar(unsigned char* data, int pixels, int channels, int r, int g, int b) {
+  with_channels<3, 4>(channels, [&](auto channels) { tint_scalar<channels>(data, pixels, r, g, b); });
+  return pixels;
+}
+
+#if defined(__x86_64__)
+
+// The SIMD kernels replace the divisions with exact multiply-shift sequences:
+//   - the grayscale value s / 1000, with s <= 255000, is computed as (s / 8) / 125 == ((s >> 3) * 33555) >> 22;
+//   - the tint value x / 255, with x <= 65025, is computed as (x * 0x8081) >> 23.
+// The grayscale kernels expand each pixel to a 32-bit lane [r g b x], while the tint kernels work directly on the
+// interleaved bytes, with a per-byte factor pattern that repeats every 3 vectors for both RGB and RGBA images.
+
+// per-byte tint factors for 3 consecutive vectors of the given size, in the order used by the unpacklo/unpackhi
+// instructions, that operate on each 16-byte lane separately
+inline void tint_factors(int channels, int r, int g, int b, int vector_size, uint16_t* lo, uint16_t* hi) {
+  // the alpha channel is left unchanged
+  const int factors[4] = {r, g, b, 255};
+  for (int v = 0; v < 3; ++v) {
+    for (int lane = 0; lane < vector_size / 16; ++lane) {
+      for (int k = 0; k < 8; ++k) {
+        int offset = v * vector_size + lane * 16 + k;
+        lo[v * vector_size / 2 + lane * 8 + k] = factors[offset % channels];
+        hi[v * vector_size / 2 + lane * 8 + k] = factors[(offset + 8) % channels];
+      }
+    }
+  }
+}
+
+// SSE4.1 kernels: 16 pixels per iteration
+
+__attribute__((target("sse4.1"))) inline __m128i gray_lanes_sse41(__m128i v) {
+  const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+  __m128i rb = _mm_and_si128(v, mask);
+  __m128i gx = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+  __m128i s =
+      _mm_add_epi32(_mm_madd_epi16(rb, _mm_set1_epi32(114 << 16 | 299)), _mm_madd_epi16(gx, _mm_set1_epi32(587)));
+  return _mm_srli_epi32(_mm_mulhi_epu16(_mm_srli_epi32(s, 3), _mm_set1_epi16(static_cast<short>(33555))), 6);
+}
+
+__attribute__((target("sse4.1"))) inline int grayscale_sse41(unsigned char* data, int pixels, int channels) {
+  int x = 0;
+  if (channels == 4) {
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+    for (; x + 16 <= pixels; x += 16) {
+      for (int i = 0; i < 4; ++i) {
+        __m128i* p = reinterpret_cast<__m128i*>(data + (x + i * 4) * 4);
+        __m128i v = _mm_loadu_si128(p);
+        __m128i y = _mm_shuffle_epi8(gray_lanes_sse41(v), spread);
+        _mm_storeu_si128(p, _mm_or_si128(y, _mm_and_si128(v, alpha)));
+      }
+    }
+  } else if (channels == 3) {
+    // each group of 4 pixels is loaded and stored as 16 bytes: the last 4 bytes belong to the next group and are
+    // written back unchanged, so the loop stops at least 2 pixels before the end of the row
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1);
+    for (; x + 16 + 2 <= pixels; x += 16) {
+      for (int i = 0; i < 4; ++i) {
+        __m128i* p = reinterpret_cast<__m128i*>(data + (x + i * 4) * 3);
+        __m128i v = _mm_loadu_si128(p);
+        __m128i y = _mm_shuffle_epi8(gray_lanes_sse41(_mm_shuffle_epi8(v, expand)), spread);
+        _mm_storeu_si128(p, _mm_blend_epi16(y, v, 0xc0));
+      }
+    }
+  }
+  return x;
+}
+
+__attribute__((target("sse4.1"))) inline __m128i tint_bytes_sse41(__m128i v, __m128i lo, __m128i hi) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i magic = _mm_set1_epi16(static_cast<short>(0x8081));
+  __m128i l = _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), lo);
+  __m128i h = _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), hi);
+  l = _mm_srli_epi16(_mm_mulhi_epu16(l, magic), 7);
+  h = _mm_srli_epi16(_mm_mulhi_epu16(h, magic), 7);
+  return _mm_packus_epi16(l, h);
+}
+
+__attribute__((target("sse4.1"))) inline int tint_sse41(
+    unsigned char* data, int pixels, int channels, int r, int g, int b) {
+  alignas(16) uint16_t lo[3 * 8];
+  alignas(16) uint16_t hi[3 * 8];
+  tint_factors(channels, r, g, b, 16, lo, hi);
+  __m128i factors[3][2];
+  for (int v = 0; v < 3; ++v) {
+    factors[v][0] = _mm_load_si128(reinterpret_cast<const __m128i*>(lo + v * 8));
+    factors[v][1] = _mm_load_si128(reinterpret_cast<const __m128i*>(hi + v * 8));
+  }
+
+  // 3 vectors hold 16 RGB or 12 RGBA pixels
+  int bytes = pixels * channels;
+  int step = 3 * 16;
+  int i = 0;
+  for (; i + step <= bytes; i += step) {
+    for (int v = 0; v < 3; ++v) {
+      __m128i* p = reinterpret_cast<__m128i*>(data + i + v * 16);
+      _mm_storeu_si128(p, tint_bytes_sse41(_mm_loadu_si128(p), factors[v][0], factors[v][1]));
+    }
+  }
+  return i / channels;
+}
+
+// AVX2 kernels: 32 pixels per iteration
+
+__attribute__((target("avx2"))) inline __m256i gray_lanes_avx2(__m256i v) {
+  const __m256i mask = _mm256_set1_epi32(0x00ff00ff);
+  __m256i rb = _mm256_and_si256(v, mask);
+  __m256i gx = _mm256_and_si256(_mm256_srli_epi32(v, 8), mask);
+  __m256i s = _mm256_add_epi32(_mm256_madd_epi16(rb, _mm256_set1_epi32(114 << 16 | 299)),
+                               _mm256_madd_epi16(gx, _mm256_set1_epi32(587)));
+  return _mm256_srli_epi32(
+      _mm256_mulhi_epu16(_mm256_srli_epi32(s, 3), _mm256_set1_epi16(static_cast<short>(33555))), 6);
+}
+
+__attribute__((target("avx2"))) inline int grayscale_avx2(unsigned char* data, int pixels, int channels) {
+  int x = 0;
+  if (channels == 4) {
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1, 0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1);
+    for (; x + 32 <= pixels; x += 32) {
+      for (int i = 0; i < 4; ++i) {
+        __m256i* p = reinterpret_cast<__m256i*>(data + (x + i * 8) * 4);
+        __m256i v = _mm256_loadu_si256(p);
+        __m256i y = _mm256_shuffle_epi8(gray_lanes_avx2(v), spread);
+        _mm256_storeu_si256(p, _mm256_or_si256(y, _mm256_and_si256(v, alpha)));
+      }
+    }
+  } else if (channels == 3) {
+    // each 16-byte lane holds a group of 4 pixels, loaded and stored as for the SSE4.1 kernel
+    const __m256i expand = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1, 0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1);
+    for (; x + 32 + 2 <= pixels; x += 32) {
+      for (int i = 0; i < 4; ++i) {
+        unsigned char* p = data + (x + i * 8) * 3;
+        __m256i v = _mm256_loadu2_m128i(reinterpret_cast<__m128i*>(p + 12), reinterpret_cast<__m128i*>(p));
+        __m256i y = _mm256_shuffle_epi8(gray_lanes_avx2(_mm256_shuffle_epi8(v, expand)), spread);
+        y = _mm256_blend_epi16(y, v, 0xc0);
+        // store the lower lane first, as its last 4 bytes overlap with the upper one
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(y));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 12), _mm256_extracti128_si256(y, 1));
+      }
+    }
+  }
+  return x;
+}
+
+__attribute__((target("avx2"))) inline __m256i tint_bytes_avx2(__m256i v, __m256i lo, __m256i hi) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i magic = _mm256_set1_epi16(static_cast<short>(0x8081));
+  __m256i l = _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), lo);
+  __m256i h = _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), hi);
+  l = _mm256_srli_epi16(_mm256_mulhi_epu16(l, magic), 7);
+  h = _mm256_srli_epi16(_mm256_mulhi_epu16(h, magic), 7);
+  return _mm256_packus_epi16(l, h);
+}
+
+__attribute__((target("avx2"))) inline int tint_avx2(
+    unsigned char* data, int pixels, int channels, int r, int g, int b) {
+  alignas(32) uint16_t lo[3 * 16];
+  alignas(32) uint16_t hi[3 * 16];
+  tint_factors(channels, r, g, b, 32, lo, hi);
+  __m256i factors[3][2];
+  for (int v = 0; v < 3; ++v) {
+    factors[v][0] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lo + v * 16));
+    factors[v][1] = _mm256_load_si256(reinterpret_cast<const __m256i*>(hi + v * 16));
+  }
+
+  // 3 vectors hold 32 RGB or 24 RGBA pixels
+  int bytes = pixels * channels;
+  int step = 3 * 32;
+  int i = 0;
+  for (; i + step <= bytes; i += step) {
+    for (int v = 0; v < 3; ++v) {
+      __m256i* p = reinterpret_cast<__m256i*>(data + i + v * 32);
+      _mm256_storeu_si256(p, tint_bytes_avx2(_mm256_loadu_si256(p), factors[v][0], factors[v][1]));
+    }
+  }
+  return i / channels;
+}
+
+// AVX-512 kernels: 64 pixels per iteration
+
+// GCC 12 warns that the shift and lane extraction intrinsics may use an uninitialized value: they pass an undefined
+// vector as the source of the masked-off elements, but with a full mask that source is never read
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512bw"))) inline __m512i gray_lanes_avx512(__m512i v) {
+  const __m512i mask = _mm512_set1_epi32(0x00ff00ff);
+  __m512i rb = _mm512_and_si512(v, mask);
+  __m512i gx = _mm512_and_si512(_mm512_srli_epi32(v, 8), mask);
+  __m512i s = _mm512_add_epi32(_mm512_madd_epi16(rb, _mm512_set1_epi32(114 << 16 | 299)),
+                               _mm512_madd_epi16(gx, _mm512_set1_epi32(587)));
+  return _mm512_srli_epi32(
+      _mm512_mulhi_epu16(_mm512_srli_epi32(s, 3), _mm512_set1_epi16(static_cast<short>(33555))), 6);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline int grayscale_avx512(unsigned char* data, int pixels, int channels) {
+  int x = 0;
+  if (channels == 4) {
+    const __m512i alpha = _mm512_set1_epi32(0xff000000);
+    // the same byte shuffle as for the SSE4.1 kernel in each 16-byte lane, as 32-bit words from the last one
+    const __m512i spread = _mm512_set4_epi32(0xff0c0c0c, 0xff080808, 0xff040404, 0xff000000);
+    for (; x + 64 <= pixels; x += 64) {
+      for (int i = 0; i < 4; ++i) {
+        unsigned char* p = data + (x + i * 16) * 4;
+        __m512i v = _mm512_loadu_si512(p);
+        __m512i y = _mm512_shuffle_epi8(gray_lanes_avx512(v), spread);
+        _mm512_storeu_si512(p, _mm512_or_si512(y, _mm512_and_si512(v, alpha)));
+      }
+    }
+  } else if (channels == 3) {
+    // each 16-byte lane holds a group of 4 pixels, loaded, shuffled and stored as for the SSE4.1 kernel
+    const __m512i expand = _mm512_set4_epi32(0xff0b0a09, 0xff080706, 0xff050403, 0xff020100);
+    const __m512i spread = _mm512_set4_epi32(0xffffffff, 0x0c0c0c08, 0x08080404, 0x04000000);
+    // the last 4 bytes of each lane are taken from the input
+    const __mmask64 tail = 0xf000f000f000f000;
+    for (; x + 64 + 2 <= pixels; x += 64) {
+      for (int i = 0; i < 4; ++i) {
+        unsigned char* p = data + (x + i * 16) * 3;
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<__m128i*>(p)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<__m128i*>(p + 12)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<__m128i*>(p + 24)), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<__m128i*>(p + 36)), 3);
+        __m512i y = _mm512_shuffle_epi8(gray_lanes_avx512(_mm512_shuffle_epi8(v, expand)), spread);
+        y = _mm512_mask_blend_epi8(tail, y, v);
+        // store the lanes in order, as the last 4 bytes of each one overlap with the next one
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_extracti32x4_epi32(y, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 12), _mm512_extracti32x4_epi32(y, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 24), _mm512_extracti32x4_epi32(y, 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 36), _mm512_extracti32x4_epi32(y, 3));
+      }
+    }
+  }
+  return x;
+}
+
+#pragma GCC diagnostic pop
+
+__attribute__((target("avx512f,avx512bw"))) inline __m512i tint_bytes_avx512(__m512i v, __m512i lo, __m512i hi) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i magic = _mm512_set1_epi16(static_cast<short>(0x8081));
+  __m512i l = _mm512_mullo_epi16(_mm512_unpacklo_epi8(v, zero), lo);
+  __m512i h = _mm512_mullo_epi16(_mm512_unpackhi_epi8(v, zero), hi);
+  l = _mm512_srli_epi16(_mm512_mulhi_epu16(l, magic), 7);
+  h = _mm512_srli_epi16(_mm512_mulhi_epu16(h, magic), 7);
+  return _mm512_packus_epi16(l, h);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline int tint_avx512(
+    unsigned char* data, int pixels, int channels, int r, int g, int b) {
+  alignas(64) uint16_t lo[3 * 32];
+  alignas(64) uint16_t hi[3 * 32];
+  tint_factors(channels, r, g, b, 64, lo, hi);
+  __m512i factors[3][2];
+  for (int v = 0; v < 3; ++v) {
+    factors[v][0] = _mm512_load_si512(lo + v * 32);
+    factors[v][1] = _mm512_load_si512(hi + v * 32);
+  }
+
+  // 3 vectors hold 64 RGB or 48 RGBA pixels
+  int bytes = pixels * channels;
+  int step = 3 * 64;
+  int i = 0;
+  for (; i + step <= bytes; i += step) {
+    for (int v = 0; v < 3; ++v) {
+      unsigned char* p = data + i + v * 64;
+      _mm512_storeu_si512(p, tint_bytes_avx512(_mm512_loadu_si512(p), factors[v][0], factors[v][1]));
+    }
+  }
+  return i / channels;
+}
+
+#endif  // defined(__x86_64__)
+
+// a set of pixel kernels for a given instruction set
+struct SimdKernels {
+  const char* name;
+  int (*grayscale)(unsigned char* data, int pixels, int channels);
+  int (*tint)(unsigned char* data, int pixels, int channels, int r, int g, int b);
+};
+
+// all the kernels supported by the current CPU, from the scalar ones to the best SIMD ones
+inline std::vector<SimdKernels> supported_simd_kernels() {
+  std::vector<SimdKernels> kernels = {{"scalar", grayscale_scalar, tint_scalar}};
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    kernels.push_back({"sse4.1", grayscale_sse41, tint_sse41});
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back({"avx2", grayscale_avx2, tint_avx2});
+  }
+  if (__builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512bw")) {
+    kernels.push_back({"avx512", grayscale_avx512, tint_avx512});
+  }
+#endif
+  return kernels;
+}
+
+// the kernels used by grayscale() and tint(): the best ones supported by the CPU, unless the SIMD environment variable
+// asks for a specific instruction set (scalar, sse4.1, avx2 or avx512)
+inline SimdKernels const& simd_kernels() {
+  static const SimdKernels kernels = [] {
+    auto supported = supported_simd_kernels();
+    const char* simd_env = std::getenv("SIMD");
+    if (simd_env != nullptr and std::strlen(simd_env) != 0) {
+      for (auto const& k : supported) {
+        if (std::strcmp(k.name, simd_env) == 0) {
+          return k;
+        }
+      }
+      std::cerr << "Instruction set " << simd_env << " not supported, using " << supported.back().name << '\n';
+    }
+    return supported.back();
+  }();
+  return kernels;
+}
+
+#endif  // simd_h
@@ -0,0 +1,378 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef tiled_image_h
+#define tiled_image_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <tbb/tbb.h>
+
+#include "channels.h"
+#include "image.h"
+#include "resample.h"
+#include "simd.h"
+#include "trace.h"
+
+// tiled image, for images larger than the available memory: the pixels are stored in square tiles, each one
+// contiguous in a scratch file mapped in memory, so the kernels can stream over the image one tile at a time and the
+// operating system can write back and evict the tiles that are not being used; all the offsets are 64-bit
+struct TiledImage {
+  // tile side, in pixels: each tile takes 64 kB per channel, a multiple of the page size
+  static constexpr int tile_size = 256;
+
+  unsigned char* data_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  int channels_ = 0;
+  int tiles_x_ = 0;
+  int tiles_y_ = 0;
+
+  TiledImage() {}
+
+  // create a blank image, backed by a new scratch file in the temporary directory
+  TiledImage(int width, int height, int channels)
+      : width_(width),
+        height_(height),
+        channels_(channels),
+        tiles_x_((width + tile_size - 1) / tile_size),
+        tiles_y_((height + tile_size - 1) / tile_size) {
+    std::string path = (std::filesystem::temp_directory_path() / "tiled-image-XXXXXX").string();
+    int fd = mkstemp(path.data());
+    if (fd < 0) {
+      throw std::runtime_error("Failed to create the scratch file " + path);
+    }
+    // the file is removed as soon as it is unmapped
+    unlink(path.c_str());
+    // reserve the disk blocks up front: a sparse file would fail with a SIGBUS when the disk fills up
+    if (posix_fallocate(fd, 0, size()) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to allocate the scratch file " + path);
+    }
+    void* mapping = mmap(nullptr, size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Failed to map the scratch file " + path);
+    }
+    data_ = static_cast<unsigned char*>(mapping);
+  }
+
+  // convert an interleaved image to the tiled layout
+  explicit TiledImage(Image const& img) : TiledImage(img.width_, img.height_, img.channels_) {
+    for_each_tile([&](int tx, int ty) {
+      int x = tx * tile_size;
+      for (int y = ty * tile_size; y < ty * tile_size + tile_height(ty); ++y) {
+        write_row(x, y, tile_width(tx), img.data_ + offset(img, x, y));
+      }
+    });
+  }
+
+  ~TiledImage() { close(); }
+
+  // the images are too large to be copied implicitly
+  TiledImage(TiledImage const& img) = delete;
+  TiledImage& operator=(TiledImage const& img) = delete;
+
+  // move constructor
+  TiledImage(TiledImage&& img)
+      : data_(img.data_),
+        width_(img.width_),
+        height_(img.height_),
+        channels_(img.channels_),
+        tiles_x_(img.tiles_x_),
+        tiles_y_(img.tiles_y_) {
+    // take owndership of the image data
+    img.data_ = nullptr;
+  }
+
+  // move assignment
+  TiledImage& operator=(TiledImage&& img) {
+    // avoid self-moves
+    if (&img == this) {
+      return *this;
+    }
+
+    // free any existing image data
+    close();
+
+    // copy the image properties
+    width_ = img.width_;
+    height_ = img.height_;
+    channels_ = img.channels_;
+    tiles_x_ = img.tiles_x_;
+    tiles_y_ = img.tiles_y_;
+
+    // take owndership of the image data
+    data_ = img.data_;
+    img.data_ = nullptr;
+
+    return *this;
+  }
+
+  // size of a tile and of the whole image data, in bytes
+  size_t tile_bytes() const { return static_cast<size_t>(tile_size) * tile_size * channels_; }
+  size_t size() const { return static_cast<size_t>(tiles_x_) * tiles_y_ * tile_bytes(); }
+
+  // valid width and height of a tile, smaller than tile_size along the right and bottom edges
+  int tile_width(int tx) const { return std::min(tile_size, width_ - tx * tile_size); }
+  int tile_height(int ty) const { return std::min(tile_size, height_ - ty * tile_size); }
+
+  // first pixel of a tile; the rows of a tile are tile_size pixels apart
+  unsigned char* tile(int tx, int ty) { return data_ + (static_cast<size_t>(ty) * tiles_x_ + tx) * tile_bytes(); }
+  const unsigned char* tile(int tx, int ty) const {
+    return data_ + (static_cast<size_t>(ty) * tiles_x_ + tx) * tile_bytes();
+  }
+
+  // pixel (x, y) of the image
+  unsigned char* pixel(int x, int y) { return tile(x / tile_size, y / tile_size) + offset_in_tile(x, y); }
+  const unsigned char* pixel(int x, int y) const { return tile(x / tile_size, y / tile_size) + offset_in_tile(x, y); }
+
+  // copy size pixels starting at (x, y) from or to a contiguous buffer, across the tile boundaries
+  void read_row(int x, int y, int size, unsigned char* out) const {
+    while (size > 0) {
+      int n = std::min(size, tile_size - x % tile_size);
+      std::memcpy(out, pixel(x, y), n * channels_);
+      x += n;
+      out += n * channels_;
+      size -= n;
+    }
+  }
+
+  void write_row(int x, int y, int size, const unsigned char* in) {
+    while (size > 0) {
+      int n = std::min(size, tile_size - x % tile_size);
+      std::memcpy(pixel(x, y), in, n * channels_);
+      x += n;
+      in += n * channels_;
+      size -= n;
+    }
+  }
+
+  // let the operating system write back a tile and drop it from the resident memory; its content is preserved
+  void release(int tx, int ty) const {
+    madvise(const_cast<unsigned char*>(tile(tx, ty)), tile_bytes(), MADV_DONTNEED);
+  }
+
+  // release all the tiles that overlap the pixels [x0, x1) x [y0, y1), after reading them
+  void release(int x0, int y0, int x1, int y1) const {
+    for (int ty = y0 / tile_size; ty <= (y1 - 1) / tile_size; ++ty) {
+      for (int tx = x0 / tile_size; tx <= (x1 - 1) / tile_size; ++tx) {
+        release(tx, ty);
+      }
+    }
+  }
+
+  // call body(tx, ty) for each tile, in parallel, releasing each tile once it has been processed; the working set
+  // is bounded by the number of threads times the size of a tile
+  template <typename Body>
+  void for_each_tile(Body&& body) {
+    tbb::parallel_for<int>(0, tiles_x_ * tiles_y_, 1, [&](int t) {
+      int tx = t % tiles_x_;
+      int ty = t / tiles_x_;
+      body(tx, ty);
+      release(tx, ty);
+    });
+  }
+
+  // convert the image back to the interleaved layout; the result must fit in memory
+  Image interleaved() const {
+    Image img(width_, height_, channels_);
+    tbb::parallel_for<int>(0, height_, 1, [&](int y) { read_row(0, y, width_, img.data_ + offset(img, 0, y)); });
+    return img;
+  }
+
+  void write(std::string const& filename) const { interleaved().write(filename); }
+
+  void close() {
+    if (data_ != nullptr) {
+      munmap(data_, size());
+    }
+    data_ = nullptr;
+  }
+
+private:
+  size_t offset_in_tile(int x, int y) const {
+    return (static_cast<size_t>(y % tile_size) * tile_size + x % tile_size) * channels_;
+  }
+
+  static size_t offset(Image const& img, int x, int y) {
+    return (static_cast<size_t>(y) * img.width_ + x) * img.channels_;
+  }
+};
+
+// tiled versions of the kernels, for images larger than the memory: each task processes one tile of the destination
+// image, so only a few tiles per thread are resident at any time; the results are identical to the interleaved ones
+
+// compute one tile of a tiled image, from the region of the source image that contributes to it; the two passes run
+// in the same order as for the interleaved images, with the same results
+template <int Channels>
+void resample_tile(Resampler const& resampler, TiledImage const& src, TiledImage& out, int tx, int ty) {
+  const bool scale_x = out.width_ != src.width_;
+  const bool scale_y = out.height_ != src.height_;
+  const int x0 = tx * TiledImage::tile_size;
+  const int x1 = x0 + out.tile_width(tx);
+  const int y0 = ty * TiledImage::tile_size;
+  const int y1 = y0 + out.tile_height(ty);
+  const int width = x1 - x0;
+
+  // source columns and rows that contribute to the tile
+  auto [sx0, sx1] = scale_x ? resampler.horizontal_span(x0, x1) : std::pair{x0, x1};
+  auto [sy0, sy1] = scale_y ? resampler.vertical_span(y0, y1) : std::pair{y0, y1};
+  const int cols = sx1 - sx0;
+  const int rows = sy1 - sy0;
+
+  std::vector<unsigned char> region(static_cast<size_t>(rows) * cols * Channels);
+  for (int r = 0; r < rows; ++r) {
+    src.read_row(sx0, sy0 + r, cols, region.data() + static_cast<size_t>(r) * cols * Channels);
+  }
+  src.release(sx0, sy0, sx1, sy1);
+
+  // the rows of the output tile are contiguous
+  if (scale_y and (not scale_x or resampler.vertical_first())) {
+    // vertical pass on the columns of the region, then horizontal pass on each row
+    std::vector<int32_t> acc(cols * Channels);
+    std::vector<unsigned char> line(cols * Channels);
+    for (int y = y0; y < y1; ++y) {
+      resampler.vertical_row(region.data(), cols * Channels, cols * Channels, y, acc.data(), line.data(), sy0);
+      if (scale_x) {
+        resampler.horizontal_row<Channels>(line.data(), out.pixel(x0, y), x0, x1, sx0);
+      } else {
+        std::memcpy(out.pixel(x0, y), line.data(), width * Channels);
+      }
+    }
+  } else {
+    // horizontal pass on the rows of the region, then vertical pass on the columns of the tile
+    std::vector<unsigned char> lines(static_cast<size_t>(rows) * width * Channels);
+    for (int r = 0; r < rows; ++r) {
+      const unsigned char* in = region.data() + static_cast<size_t>(r) * cols * Channels;
+      unsigned char* line = lines.data() + static_cast<size_t>(r) * width * Channels;
+      if (scale_x) {
+        resampler.horizontal_row<Channels>(in, line, x0, x1, sx0);
+      } else {
+        std::memcpy(line, in, width * Channels);
+      }
+    }
+    std::vector<int32_t> acc(width * Channels);
+    for (int y = y0; y < y1; ++y) {
+      if (scale_y) {
+        resampler.vertical_row(lines.data(), width * Channels, width * Channels, y, acc.data(), out.pixel(x0, y), sy0);
+      } else {
+        const unsigned char* line = lines.data() + static_cast<size_t>(y - y0) * width * Channels;
+        std::memcpy(out.pixel(x0, y), line, width * Channels);
+      }
+    }
+  }
+}
+
+// make a scaled copy of a tiled image one output tile at a time: each task reads only the part of the source image
+// that contributes to its tile
+inline TiledImage scale(TiledImage const& src, int width, int height, Filter filter = Filter::Bilinear) {
+  TraceScope trace("scale");
+  assert(src.channels_ <= 4);
+
+  auto resampler = Resampler::get(src.width_, src.height_, width, height, filter);
+  TiledImage out(width, height, src.channels_);
+  with_channels<1, 2, 3, 4>(src.channels_, [&](auto channels) {
+    out.for_each_tile([&](int tx, int ty) { resample_tile<channels>(*resampler, src, out, tx, ty); });
+  });
+  return out;
+}
+
+// copy a source tiled image into a target tiled image, cropping any parts that fall outside the target image
+inline void write_to(TiledImage const& src, TiledImage& dst, int x, int y) {
+  TraceScope trace("write_to");
+  // copying to an image with a different number of channels is not supported
+  assert(src.channels_ == dst.channels_);
+
+  dst.for_each_tile([&](int tx, int ty) {
+    // the part of the tile covered by the source image
+    int x_from = std::max(tx * TiledImage::tile_size, x);
+    int x_to = std::min(tx * TiledImage::tile_size + dst.tile_width(tx), x + src.width_);
+    int y_from = std::max(ty * TiledImage::tile_size, y);
+    int y_to = std::min(ty * TiledImage::tile_size + dst.tile_height(ty), y + src.height_);
+    if (x_from >= x_to or y_from >= y_to) {
+      return;
+    }
+    for (int row = y_from; row < y_to; ++row) {
+      src.read_row(x_from - x, row - y, x_to - x_from, dst.pixel(x_from, row));
+    }
+    src.release(x_from - x, y_from - y, x_to - x, y_to - y);
+  });
+}
+
+// convert a tiled image to grayscale, in place; each tile is converted as a single contiguous span, including the
+// unused part of the tiles along the edges; the images without colour channels are already grayscale
+inline void grayscale_inplace(TiledImage& img) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  TraceScope trace("grayscale");
+  auto const& kernels = simd_kernels();
+  with_channels<3, 4>(img.channels_, [&](auto channels) {
+    img.for_each_tile([&](int tx, int ty) {
+      unsigned char* data = img.tile(tx, ty);
+      const int pixels = TiledImage::tile_size * TiledImage::tile_size;
+      int done = kernels.grayscale(data, pixels, channels);
+      grayscale_scalar<channels>(data + done * channels, pixels - done);
+    });
+  });
+}
+
+// convert a tiled image to grayscale, reusing its scratch file
+inline TiledImage grayscale(TiledImage&& src) {
+  grayscale_inplace(src);
+  return std::move(src);
+}
+
+// apply an RGB tint to a tiled image, in place; the images without colour channels are left unchanged
+inline void tint_inplace(TiledImage& img, int r, int g, int b) {
+  if (img.channels_ < 3) {
+    return;
+  }
+
+  TraceScope trace("tint");
+  auto const& kernels = simd_kernels();
+  with_channels<3, 4>(img.channels_, [&](auto channels) {
+    img.for_each_tile([&](int tx, int ty) {
+      unsigned char* data = img.tile(tx, ty);
+      const int pixels = TiledImage::tile_size * TiledImage::tile_size;
+      int done = kernels.tint(data, pixels, channels, r, g, b);
+      tint_scalar<channels>(data + done * channels, pixels - done, r, g, b);
+    });
+  });
+}
+
+// apply an RGB tint to a tiled image, reusing its scratch file
+inline TiledImage tint(TiledImage&& src, int r, int g, int b) {
+  tint_inplace(src, r, g, b);
+  return std::move(src);
+}
+
+#endif  // tiled_image_h
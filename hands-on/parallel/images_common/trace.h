@@ -0,0 +1,185 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef trace_h
+#define trace_h
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Lightweight tracing of the flow graph nodes and of the kernels: each thread appends the events it records to its
+// own buffer, without any locking; at the end of the run the events are written in the Chrome trace format, that can
+// be loaded in Perfetto or chrome://tracing, and summarised with the latency percentiles of each stage.
+class TraceRecorder {
+public:
+  struct Event {
+    const char* name;
+    int64_t start;  // ns since the start of the run
+    int64_t stop;   // ns since the start of the run
+    int image;
+  };
+
+  static TraceRecorder& instance() {
+    static TraceRecorder recorder;
+    return recorder;
+  }
+
+  // tracing is enabled by setting TRACE to the name of the output file
+  bool enabled() const { return enabled_; }
+
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count();
+  }
+
+  void record(Event const& event) { buffer().events.push_back(event); }
+
+  // write the trace file and print the per-stage summary; call it only once all the threads are idle
+  void dump() {
+    if (not enabled_) {
+      return;
+    }
+
+    std::ofstream out(filename_);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    std::map<std::string, std::vector<int64_t>> durations;
+    for (auto const& thread : threads_) {
+      for (auto const& event : thread->events) {
+        // complete events, with the timestamps in microseconds
+        out << (first ? "" : ",\n")
+            << std::format(R"({{"name":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f},)"
+                           R"("args":{{"image":{}}}}})",
+                           event.name,
+                           thread->id,
+                           event.start / 1.e3,
+                           (event.stop - event.start) / 1.e3,
+                           event.image);
+        first = false;
+        durations[event.name].push_back(event.stop - event.start);
+      }
+    }
+    out << "\n]}\n";
+    if (not out) {
+      std::cerr << "Error while writing the trace file " << filename_ << '\n';
+    }
+
+    std::cerr << std::format(
+        "{:<16} {:>8} {:>10} {:>10} {:>10} {:>10}\n", "stage", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for (auto& [name, values] : durations) {
+      std::sort(values.begin(), values.end());
+      // nearest-rank percentiles, in ms
+      auto percentile = [&values](double p) {
+        size_t rank = std::max<size_t>(std::ceil(p * values.size()), 1);
+        return values[rank - 1] / 1.e6;
+      };
+      std::cerr << std::format("{:<16} {:8} {:10.3f} {:10.3f} {:10.3f} {:10.3f}\n",
+                               name,
+                               values.size(),
+                               percentile(0.50),
+                               percentile(0.95),
+                               percentile(0.99),
+                               values.back() / 1.e6);
+    }
+  }
+
+private:
+  // events recorded by one thread
+  struct ThreadBuffer {
+    int id;
+    std::vector<Event> events;
+  };
+
+  TraceRecorder() : origin_(std::chrono::steady_clock::now()) {
+    const char* trace_env = std::getenv("TRACE");
+    if (trace_env != nullptr and std::strlen(trace_env) != 0) {
+      enabled_ = true;
+      filename_ = trace_env;
+    }
+  }
+
+  // the buffer of the calling thread, registered the first time the thread records an event
+  ThreadBuffer& buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      threads_.push_back(std::make_unique<ThreadBuffer>());
+      buffer = threads_.back().get();
+      buffer->id = threads_.size() - 1;
+      buffer->events.reserve(1024);
+    }
+    return *buffer;
+  }
+
+  bool enabled_ = false;
+  std::string filename_;
+  std::chrono::steady_clock::time_point origin_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> threads_;
+};
+
+// record the execution of a node or a kernel, from the construction to the destruction of the object; the nested
+// scopes inherit the image being processed by the enclosing ones
+class TraceScope {
+public:
+  explicit TraceScope(const char* name) : TraceScope(name, current_image()) {}
+
+  TraceScope(const char* name, int image) : name_(name), image_(image), previous_(current_image()) {
+    if (TraceRecorder::instance().enabled()) {
+      current_image() = image;
+      start_ = TraceRecorder::instance().now();
+    }
+  }
+
+  ~TraceScope() {
+    if (TraceRecorder::instance().enabled()) {
+      TraceRecorder::instance().record({name_, start_, TraceRecorder::instance().now(), image_});
+      current_image() = previous_;
+    }
+  }
+
+  // change the image being processed, once it is known
+  void set_image(int image) {
+    image_ = image;
+    current_image() = image;
+  }
+
+private:
+  static int& current_image() {
+    thread_local int image = -1;
+    return image;
+  }
+
+  const char* name_;
+  int image_;
+  int previous_;
+  int64_t start_ = 0;
+};
+
+#endif  // trace_h
@@ -0,0 +1,246 @@
+/*
+Copyright (C) 2026 Andrea Bocci
+SPDX-License-Identifier: GNU General Public License v3.0 or later
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef tuner_h
+#define tuner_h
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include <tbb/tbb.h>
+
+// Adaptive scheduling of the parallel loops over the image rows: for each kernel, image size class and number of
+// threads the tuner measures a set of grain sizes and partitioners on the first calls and keeps the fastest one; the
+// results are saved to a cache file at the end of the run, and loaded by the later runs at startup, that resume the
+// tuning where it was left.
+enum class Partitioner { Simple, Auto, Static, Affinity };
+
+constexpr const char* partitioner_names[] = {"simple", "auto", "static", "affinity"};
+
+struct Schedule {
+  int grain = 1;
+  Partitioner partitioner = Partitioner::Auto;
+};
+
+class Tuner {
+public:
+  static Tuner& instance() {
+    static Tuner tuner;
+    return tuner;
+  }
+
+  // run the body over the rows [0, rows) of an image with cols pixels per row; the body is called either for each
+  // row, or for each tbb::blocked_range of rows
+  template <typename Body>
+  void parallel_for(const char* kernel, int rows, int cols, Body const& body) {
+    // without TUNING, use the default grain size and partitioner
+    if (not enabled_) {
+      run(Schedule{}, nullptr, rows, body);
+      return;
+    }
+
+    // each size class covers a 4x range in the number of pixels
+    Key key{kernel, std::bit_width(static_cast<uint64_t>(rows) * cols) / 2, tbb::this_task_arena::max_concurrency()};
+    Entry* entry;
+    Schedule schedule;
+    bool measure = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      entry = &entries_[key];
+      if (entry->trials < trials()) {
+        // try the next candidate
+        schedule = candidate(entry->trials++);
+        measure = true;
+      } else {
+        schedule = entry->best;
+      }
+    }
+
+    if (not measure) {
+      run(schedule, entry, rows, body);
+      return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    run(schedule, entry, rows, body);
+    auto finish = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ms < entry->best_ms) {
+      entry->best = schedule;
+      entry->best_ms = ms;
+    }
+  }
+
+  // write the tuned schedules to the cache file, together with the number of candidates tried so far, and report how
+  // many have been saved if verbose is set
+  void save(bool verbose) {
+    if (not enabled_) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ofstream out(filename_);
+    int saved = 0;
+    for (auto const& [key, entry] : entries_) {
+      if (entry.best_ms == std::numeric_limits<float>::infinity()) {
+        continue;
+      }
+      auto const& [kernel, size_class, threads] = key;
+      out << std::format("{} {} {} {} {} {:.3f} {}\n",
+                         kernel,
+                         size_class,
+                         threads,
+                         entry.best.grain,
+                         partitioner_names[static_cast<int>(entry.best.partitioner)],
+                         entry.best_ms,
+                         entry.trials);
+      ++saved;
+    }
+    if (not out) {
+      std::cerr << "Error while writing the tuning cache " << filename_ << '\n';
+    } else if (verbose) {
+      std::cerr << std::format("tuning: {} schedules saved to {}", saved, filename_) << '\n';
+    }
+  }
+
+private:
+  // kernel name, size class, number of threads; the kernel names must not contain spaces
+  using Key = std::tuple<std::string, int, int>;
+
+  struct Entry {
+    Schedule best;
+    float best_ms = std::numeric_limits<float>::infinity();
+    // number of candidates tried so far
+    int trials = 0;
+    // the affinity partitioner replays the previous mapping of the iterations to the threads, so it must persist
+    // across the calls; concurrent calls for the same entry use a new one instead
+    tbb::affinity_partitioner affinity;
+    std::atomic_flag affinity_busy;
+  };
+
+  static constexpr int grains[] = {1, 4, 16, 64};
+  static constexpr int rounds = 2;
+
+  // each combination of grain size and partitioner is measured once per round, to reduce the effect of noise
+  static constexpr int trials() { return std::size(grains) * std::size(partitioner_names) * rounds; }
+
+  static Schedule candidate(int trial) {
+    int index = trial % (std::size(grains) * std::size(partitioner_names));
+    return Schedule{grains[index % std::size(grains)], static_cast<Partitioner>(index / std::size(grains))};
+  }
+
+  // tuning is enabled by setting TUNING to the name of the cache file
+  Tuner() {
+    const char* tuning_env = std::getenv("TUNING");
+    if (tuning_env == nullptr or std::strlen(tuning_env) == 0) {
+      return;
+    }
+    enabled_ = true;
+    filename_ = tuning_env;
+
+    // load the schedules tuned by the previous runs, if any
+    std::ifstream in(filename_);
+    std::string kernel, partitioner;
+    int size_class, threads, grain, tried;
+    float ms;
+    while (in >> kernel >> size_class >> threads >> grain >> partitioner >> ms >> tried) {
+      auto name = std::find(std::begin(partitioner_names), std::end(partitioner_names), partitioner);
+      if (name == std::end(partitioner_names) or grain < 1) {
+        continue;
+      }
+      Entry& entry = entries_[Key{kernel, size_class, threads}];
+      entry.best = Schedule{grain, static_cast<Partitioner>(name - std::begin(partitioner_names))};
+      entry.best_ms = ms;
+      entry.trials = std::clamp(tried, 1, trials());
+    }
+  }
+
+  template <typename Body>
+  static void run(Schedule schedule, Entry* entry, int rows, Body const& body) {
+    tbb::blocked_range<int> range(0, rows, schedule.grain);
+    auto loop = [&body](tbb::blocked_range<int> const& range) {
+      if constexpr (std::is_invocable_v<Body const&, int>) {
+        for (int y = range.begin(); y < range.end(); ++y) {
+          body(y);
+        }
+      } else {
+        body(range);
+      }
+    };
+
+    switch (schedule.partitioner) {
+      case Partitioner::Simple:
+        tbb::parallel_for(range, loop, tbb::simple_partitioner());
+        break;
+      case Partitioner::Auto:
+        tbb::parallel_for(range, loop, tbb::auto_partitioner());
+        break;
+      case Partitioner::Static:
+        tbb::parallel_for(range, loop, tbb::static_partitioner());
+        break;
+      case Partitioner::Affinity:
+        if (entry != nullptr and not entry->affinity_busy.test_and_set()) {
+          tbb::parallel_for(range, loop, entry->affinity);
+          entry->affinity_busy.clear();
+        } else {
+          tbb::affinity_partitioner affinity;
+          tbb::parallel_for(range, loop, affinity);
+        }
+        break;
+    }
+  }
+
+  bool enabled_ = false;
+  std::string filename_;
+  std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+};
+
+// run a kernel over the rows of an image, with the grain size and partitioner chosen by the tuner
+template <typename Body>
+void tuned_for(const char* kernel, int rows, int cols, Body const& body) {
+  Tuner::instance().parallel_for(kernel, rows, cols, body);
+}
+
+// loop policy for the image-level operations, like Resampler::apply() and mosaic(): split the rows among the tasks
+// as chosen by the tuner
+struct TunedRows {
+  template <typename Body>
+  void operator()(const char* kernel, int rows, int cols, Body const& body) const {
+    tuned_for(kernel, rows, cols, [&](tbb::blocked_range<int> const& range) { body(range.begin(), range.end()); });
+  }
+};
+
+#endif  // tuner_h